@@ -0,0 +1,149 @@
+#include "address_translator.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+namespace
+{
+
+// Reads the section table out of the PE headers of a loaded module. Returns (virtual address, virtual size) pairs
+// relative to the module base in the same order as the section table.
+std::vector<std::pair<IntPtr, IntPtr>> ReadModuleSections(HANDLE process, const ModuleInfo &module)
+{
+	MemoryObject<IMAGE_DOS_HEADER> dos_header;
+	dos_header.address = module.base_address;
+	dos_header.ReRead(process);
+	if (dos_header.value.e_magic != IMAGE_DOS_SIGNATURE) {
+		throw MemoryScannerException("Module does not start with a DOS header", 0,
+			reinterpret_cast<const void *>(module.base_address));
+	}
+	MemoryObject<IMAGE_NT_HEADERS64> nt_headers;
+	nt_headers.address = module.base_address + dos_header.value.e_lfanew;
+	nt_headers.ReRead(process);
+	if (nt_headers.value.Signature != IMAGE_NT_SIGNATURE) {
+		throw MemoryScannerException("Module does not have NT headers", 0,
+			reinterpret_cast<const void *>(module.base_address));
+	}
+	const IMAGE_FILE_HEADER &file_header = nt_headers.value.FileHeader;
+	MemoryRegion table;
+	table.base_address = nt_headers.address + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER) +
+		file_header.SizeOfOptionalHeader;
+	table.length = file_header.NumberOfSections * sizeof(IMAGE_SECTION_HEADER);
+	if (ReadRegionData(process, table) != table.length) {
+		throw MemoryScannerException("Cannot read module section table", 0,
+			reinterpret_cast<const void *>(table.base_address));
+	}
+	const IMAGE_SECTION_HEADER *const headers = reinterpret_cast<const IMAGE_SECTION_HEADER *>(table.data.get());
+	std::vector<std::pair<IntPtr, IntPtr>> sections;
+	sections.reserve(file_header.NumberOfSections);
+	for (WORD i = 0; i < file_header.NumberOfSections; ++i) {
+		sections.emplace_back(headers[i].VirtualAddress, headers[i].Misc.VirtualSize);
+	}
+	return sections;
+}
+
+}  // namespace
+
+AddressTranslator::AddressTranslator(HANDLE process) : modules(EnumerateModules(process))
+{
+	first_span.reserve(modules.size());
+	span_count.reserve(modules.size());
+	for (std::uint32_t m = 0; m < modules.size(); ++m) {
+		const std::vector<std::pair<IntPtr, IntPtr>> sections = ReadModuleSections(process, modules[m]);
+		first_span.push_back(static_cast<std::uint32_t>(spans.size()));
+		span_count.push_back(static_cast<std::uint16_t>(sections.size()));
+		for (std::uint16_t s = 0; s < sections.size(); ++s) {
+			spans.push_back(SectionSpan{
+				.begin = modules[m].base_address + sections[s].first,
+				.end = modules[m].base_address + sections[s].first + sections[s].second,
+				.module_id = m,
+				.section = s,
+			});
+		}
+	}
+	// Modules are sorted and the PE format requires sections in ascending address order, so `spans` is already sorted
+	// and the sections of each module are contiguous in section table order.
+}
+
+std::optional<ModuleKey> AddressTranslator::ToKey(const IntPtr address) const
+{
+	// Find the last span starting at or before the address.
+	auto it = std::upper_bound(spans.begin(), spans.end(), address,
+		[](const IntPtr value, const SectionSpan &span) { return value < span.begin; });
+	if (it == spans.begin()) {
+		return std::nullopt;
+	}
+	--it;
+	if (address >= it->end) {
+		return std::nullopt;
+	}
+	return ModuleKey{
+		.module_id = it->module_id,
+		.section = it->section,
+		.offset = static_cast<std::uint32_t>(address - it->begin),
+	};
+}
+
+std::optional<IntPtr> AddressTranslator::ToAddress(const ModuleKey &key) const
+{
+	if (key.module_id >= modules.size() || key.section >= span_count[key.module_id]) {
+		return std::nullopt;
+	}
+	const SectionSpan &span = spans[first_span[key.module_id] + key.section];
+	if (span.begin + key.offset >= span.end) {
+		return std::nullopt;
+	}
+	return span.begin + key.offset;
+}
+
+CandidateSet AddressTranslator::MakeCandidateSet(const std::vector<IntPtr> &addresses) const
+{
+	CandidateSet candidate_set;
+	candidate_set.modules = modules;
+	candidate_set.keys.reserve(addresses.size());
+	for (const IntPtr address : addresses) {
+		if (const std::optional<ModuleKey> key = ToKey(address)) {
+			candidate_set.keys.push_back(*key);
+		}
+	}
+	std::sort(candidate_set.keys.begin(), candidate_set.keys.end());
+	return candidate_set;
+}
+
+std::vector<IntPtr> AddressTranslator::ResolveCandidateSet(const CandidateSet &candidate_set) const
+{
+	// Map the modules of the other process to ours once rather than once per key.
+	std::vector<size_t> module_map(candidate_set.modules.size(), modules.size());
+	for (size_t m = 0; m < candidate_set.modules.size(); ++m) {
+		const size_t found = FindModuleByName(modules, candidate_set.modules[m].name);
+		if (found != modules.size() && modules[found].length == candidate_set.modules[m].length) {
+			module_map[m] = found;
+		}
+	}
+	std::vector<IntPtr> addresses;
+	addresses.reserve(candidate_set.keys.size());
+	for (ModuleKey key : candidate_set.keys) {
+		if (key.module_id >= module_map.size() || module_map[key.module_id] == modules.size()) {
+			continue;
+		}
+		key.module_id = static_cast<std::uint32_t>(module_map[key.module_id]);
+		if (const std::optional<IntPtr> address = ToAddress(key)) {
+			addresses.push_back(*address);
+		}
+	}
+	std::sort(addresses.begin(), addresses.end());
+	return addresses;
+}
+
+}  // namespace memory_scanner
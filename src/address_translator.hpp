@@ -0,0 +1,86 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <compare>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "memory_scanner.hpp"
+#include "module_map.hpp"
+
+namespace memory_scanner
+{
+
+// An address expressed as an offset into a section of a module. Unlike an `IntPtr` it survives ASLR and restarts of
+// the process, as long as the module is the same build.
+class ModuleKey
+{
+public:
+	// Index into the modules the key was made against.
+	std::uint32_t module_id = 0;
+	// Index into the PE section table of the module.
+	std::uint16_t section = 0;
+	// Offset from the start of the section.
+	std::uint32_t offset = 0;
+
+	auto operator<=>(const ModuleKey &) const = default;
+};
+
+// Candidate addresses stored as `ModuleKey`s so they can be re-applied to another instance of the same program.
+class CandidateSet
+{
+public:
+	// What `ModuleKey::module_id` refers to. Only the name and length are meaningful in another process.
+	std::vector<ModuleInfo> modules;
+	// Sorted from low to high.
+	std::vector<ModuleKey> keys;
+};
+
+// Translates between absolute addresses and `ModuleKey`s for one process. The module and section layout is captured
+// once on construction, after which every translation is a binary search. Create a new translator if the process
+// loads or unloads modules.
+class AddressTranslator
+{
+public:
+	explicit AddressTranslator(HANDLE process);
+
+	const std::vector<ModuleInfo> &Modules() const { return modules; }
+
+	// Returns the key for the address, or nothing if the address is not inside a section of any module.
+	std::optional<ModuleKey> ToKey(IntPtr address) const;
+
+	// Returns the address for a key made by this translator, or nothing if the key is out of bounds.
+	std::optional<IntPtr> ToAddress(const ModuleKey &key) const;
+
+	// Converts addresses, for example the result of `NextScan`, into a candidate set. Addresses outside of module
+	// sections are dropped since they cannot be found again in another process.
+	CandidateSet MakeCandidateSet(const std::vector<IntPtr> &addresses) const;
+
+	// Converts a candidate set made by a translator of any process back into addresses of this process, sorted from low
+	// to high. Keys of modules that are missing here or have a different length are dropped.
+	std::vector<IntPtr> ResolveCandidateSet(const CandidateSet &candidate_set) const;
+
+private:
+	class SectionSpan
+	{
+	public:
+		IntPtr begin = 0;
+		IntPtr end = 0;
+		std::uint32_t module_id = 0;
+		std::uint16_t section = 0;
+	};
+
+	std::vector<ModuleInfo> modules;
+	// Every section of every module, sorted by address.
+	std::vector<SectionSpan> spans;
+	// Per module, the index of its first entry in `spans` and the number of sections.
+	std::vector<std::uint32_t> first_span;
+	std::vector<std::uint16_t> span_count;
+};
+
+}  // namespace memory_scanner
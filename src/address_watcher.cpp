@@ -0,0 +1,158 @@
+#include "address_watcher.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+
+AddressWatcher::AddressWatcher(HANDLE process, const WatchOptions &options) : process(process), options(options)
+{
+	if (options.min_interval.count() <= 0 || options.max_interval < options.min_interval) {
+		throw MemoryScannerException("Watch intervals must be positive and min_interval <= max_interval");
+	}
+	tier_due.resize(TierOf(static_cast<double>(options.max_interval / options.min_interval)) + 1, Clock::now());
+}
+
+void AddressWatcher::Watch(const IntPtr address, const size_t size)
+{
+	if (size == 0 || size > sizeof(std::uint64_t)) {
+		throw MemoryScannerException("Watched values must be 1 to 8 bytes", 0, reinterpret_cast<void *>(address));
+	}
+	const auto it = std::lower_bound(watched.begin(), watched.end(), address,
+		[](const Watched &w, const IntPtr a) { return w.address < a; });
+	if (it != watched.end() && it->address == address) {
+		it->size = size;
+		it->has_value = false;
+		return;
+	}
+	watched.insert(it, Watched{ .address = address, .size = size });
+}
+
+void AddressWatcher::Unwatch(const IntPtr address)
+{
+	const auto it = std::lower_bound(watched.begin(), watched.end(), address,
+		[](const Watched &w, const IntPtr a) { return w.address < a; });
+	if (it != watched.end() && it->address == address) {
+		watched.erase(it);
+	}
+}
+
+size_t AddressWatcher::TierOf(const double interval) const
+{
+	const size_t tier = static_cast<size_t>(std::floor(std::log2(std::max(interval, 1.0))));
+	return tier_due.empty() ? tier : std::min(tier, tier_due.size() - 1);
+}
+
+AddressWatcher::Clock::duration AddressWatcher::TierPeriod(const size_t tier) const
+{
+	return std::min<Clock::duration>(options.min_interval * (std::uint64_t(1) << tier), options.max_interval);
+}
+
+void AddressWatcher::Learn(Watched &w, const bool changed) const
+{
+	const double max_interval = static_cast<double>(options.max_interval / options.min_interval);
+	w.interval = std::clamp(w.interval * (changed ? options.speed_up : options.slow_down), 1.0, max_interval);
+	w.tier = TierOf(w.interval);
+}
+
+size_t AddressWatcher::PollOnce(const ChangeFn &on_change)
+{
+	// Pick the tier that is due first among those holding any address.
+	std::vector<char> occupied(tier_due.size(), 0);
+	for (const Watched &w : watched) {
+		occupied[w.tier] = 1;
+	}
+	size_t tier = tier_due.size();
+	for (size_t t = 0; t < tier_due.size(); ++t) {
+		if (occupied[t] && (tier == tier_due.size() || tier_due[t] < tier_due[tier])) {
+			tier = t;
+		}
+	}
+	if (tier == tier_due.size()) {
+		return 0;
+	}
+	std::this_thread::sleep_until(tier_due[tier]);
+	const Clock::time_point now = Clock::now();
+	tier_due[tier] = now + TierPeriod(tier);
+
+	// Gather the addresses of the tier, which are already sorted, into spans that are each read at once. Learning
+	// moves addresses between tiers, so remember them before any of that happens.
+	std::vector<size_t> polled;
+	for (size_t i = 0; i < watched.size(); ++i) {
+		if (watched[i].tier == tier) {
+			polled.push_back(i);
+		}
+	}
+	std::vector<char> buffer;
+	for (size_t first = 0; first < polled.size();) {
+		const IntPtr begin = watched[polled[first]].address;
+		IntPtr end = begin + watched[polled[first]].size;
+		size_t last = first + 1;
+		while (last < polled.size() && watched[polled[last]].address <= end + options.max_batch_gap) {
+			end = std::max(end, watched[polled[last]].address + watched[polled[last]].size);
+			++last;
+		}
+		buffer.resize(end - begin);
+		const SIZE_T bytes_read = ReadMemory(process, begin, buffer.data(), buffer.size());
+		++read_count;
+		for (size_t p = first; p < last; ++p) {
+			Watched &w = watched[polled[p]];
+			const IntPtr offset = w.address - begin;
+			std::uint64_t value = 0;
+			if (offset + w.size <= bytes_read) {
+				std::memcpy(&value, buffer.data() + offset, w.size);
+			} else {
+				// The span read short, for example because a page in a gap between the addresses is not readable. Read
+				// the address on its own so it is still polled.
+				const SIZE_T value_read = ReadMemory(process, w.address, reinterpret_cast<char *>(&value), w.size);
+				++read_count;
+				if (value_read != w.size) {
+					continue;
+				}
+			}
+			const bool changed = w.has_value && value != w.value;
+			if (changed) {
+				on_change(ValueChange{ w.address, w.size, w.value, value, now });
+			}
+			w.value = value;
+			w.has_value = true;
+			Learn(w, changed);
+		}
+		first = last;
+	}
+	return polled.size();
+}
+
+void AddressWatcher::Run(const ChangeFn &on_change, const std::function<bool()> &keep_running)
+{
+	while (keep_running()) {
+		if (PollOnce(on_change) == 0) {
+			std::this_thread::sleep_for(options.max_interval);
+		}
+	}
+}
+
+AddressWatcher::Clock::duration AddressWatcher::IntervalOf(const IntPtr address) const
+{
+	const auto it = std::lower_bound(watched.begin(), watched.end(), address,
+		[](const Watched &w, const IntPtr a) { return w.address < a; });
+	if (it == watched.end() || it->address != address) {
+		throw MemoryScannerException("Address is not watched", 0, reinterpret_cast<void *>(address));
+	}
+	return TierPeriod(it->tier);
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,119 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "memory_scanner.hpp"
+
+namespace memory_scanner
+{
+
+// A value the watcher saw change. Values are kept as their raw bytes, use `ValueAs<T>` to get them back.
+class ValueChange
+{
+public:
+	IntPtr address;
+	size_t size;
+	std::uint64_t old_value;
+	std::uint64_t new_value;
+	std::chrono::steady_clock::time_point time;
+};
+
+// Returns the value whose raw bytes are the first `sizeof(T)` bytes of `raw`.
+template<typename T>
+T ValueAs(std::uint64_t raw);
+
+class WatchOptions
+{
+public:
+	// The bounds of the poll interval of any address. Addresses start at `min_interval` and slow down while they do not
+	// change.
+	std::chrono::milliseconds min_interval{ 10 };
+	std::chrono::milliseconds max_interval{ 1000 };
+	// The interval of an address is multiplied by `speed_up` after a poll where it changed and by `slow_down` after one
+	// where it did not.
+	double speed_up = 0.5;
+	double slow_down = 1.25;
+	// Addresses polled together are read with a single ReadProcessMemory as long as the gap between them is at most
+	// this many bytes.
+	IntPtr max_batch_gap = 4096;
+};
+
+// Polls a set of addresses, learning how often each one changes. Addresses that change often are polled close to
+// `min_interval` and static ones drift towards `max_interval`. The intervals are rounded to powers of two times
+// `min_interval`, so addresses with similar rates share a tier that is polled at once, and nearby addresses of a tier
+// share reads.
+class AddressWatcher
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	using ChangeFn = std::function<void(const ValueChange &)>;
+
+	explicit AddressWatcher(HANDLE process, const WatchOptions &options = WatchOptions());
+
+	// Starts polling `size` bytes at `address`, at most 8. The first poll only records the value.
+	void Watch(IntPtr address, size_t size);
+
+	void Unwatch(IntPtr address);
+
+	size_t WatchCount() const { return watched.size(); }
+
+	// Sleeps until the next tier is due, polls it and calls `on_change` for every value that changed. Returns the
+	// number of addresses polled, which is 0 if nothing is watched.
+	size_t PollOnce(const ChangeFn &on_change);
+
+	// Calls PollOnce until `keep_running` returns false.
+	void Run(const ChangeFn &on_change, const std::function<bool()> &keep_running);
+
+	// The current poll interval of a watched address.
+	Clock::duration IntervalOf(IntPtr address) const;
+
+	// The number of ReadProcessMemory calls so far.
+	size_t ReadCount() const { return read_count; }
+
+private:
+	struct Watched {
+		IntPtr address;
+		size_t size;
+		std::uint64_t value = 0;
+		bool has_value = false;
+		// The learned interval, in units of `min_interval`.
+		double interval = 1;
+		size_t tier = 0;
+	};
+
+	size_t TierOf(double interval) const;
+	Clock::duration TierPeriod(size_t tier) const;
+	void Learn(Watched &watched, bool changed) const;
+
+	HANDLE process;
+	WatchOptions options;
+	// Sorted by address.
+	std::vector<Watched> watched;
+	// When each tier is due next.
+	std::vector<Clock::time_point> tier_due;
+	size_t read_count = 0;
+};
+
+//
+// Implementations of templated functions below...
+//
+
+template<typename T>
+T ValueAs(const std::uint64_t raw)
+{
+	static_assert(sizeof(T) <= sizeof(raw), "Watched values are at most 8 bytes");
+	T value;
+	std::memcpy(&value, &raw, sizeof(T));
+	return value;
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,174 @@
+// Benchmarks for the scanning functions. Everything scans buffers owned by this process through its own handle so no
+// target program is needed, which also means ReadProcessMemory costs about as much as a memcpy.
+//
+// numa: NextScanAll throughput with one worker, with every hardware thread, and with every hardware thread pinned to
+// NUMA nodes. On a machine with a single node the last two should match.
+//
+// sparse: the restricted NextScan at decreasing candidate densities, once with prefetching and page batching turned off
+// and once with the default ScanTuning.
+//
+// byte order: NextScan throughput over the same buffer scanned as native and as big-endian values, which should match
+// on CPUs with AVX2, where the byte swaps are dispatched to vector shuffles at runtime.
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <iostream>
+#include <ostream>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "filter_combinators.hpp"
+#include "memory_scanner.hpp"
+#include "memory_scanner_exception.hpp"
+#include "multi_target_scan.hpp"
+#include "numa.hpp"
+#include "scan_types.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t num_targets = 4;
+constexpr size_t values_per_target = size_t(64) << 20;
+
+double SecondsSince(const Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Fake targets that all point back into this process, each with its own buffer of random values.
+std::vector<memory_scanner::ScanTarget> MakeTargets(std::vector<std::vector<int32_t>> &buffers)
+{
+	const HANDLE self = GetCurrentProcess();
+	std::vector<memory_scanner::ScanTarget> targets(buffers.size());
+	for (size_t t = 0; t < buffers.size(); ++t) {
+		const auto begin = reinterpret_cast<memory_scanner::IntPtr>(buffers[t].data());
+		const memory_scanner::IntPtr end = begin + buffers[t].size() * sizeof(int32_t);
+		targets[t].process = self;
+		targets[t].regions = memory_scanner::QueryRegions(self, begin, end);
+	}
+	return targets;
+}
+
+void BenchNuma(std::vector<std::vector<int32_t>> &buffers)
+{
+	std::cout << "numa: " << memory_scanner::NumaNodeCount() << " node(s)" << std::endl;
+	const unsigned hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+	struct Config {
+		std::string_view name;
+		unsigned workers;
+		bool pinned;
+	};
+	for (const Config &config : { Config{ "1 worker", 1, false }, Config{ "all workers", hardware_threads, false },
+			 Config{ "all workers pinned", hardware_threads, true } }) {
+		memory_scanner::WorkStealingPool pool(config.workers, config.pinned);
+		std::vector<memory_scanner::ScanTarget> targets = MakeTargets(buffers);
+		// Read the regions from inside the pool so buffers are placed by the workers.
+		memory_scanner::IntPtr total_bytes = 0;
+		for (memory_scanner::ScanTarget &target : targets) {
+			for (memory_scanner::MemoryRegion &region : target.regions) {
+				total_bytes += region.length;
+				pool.Submit([&target, &region] { memory_scanner::ReadRegionData(target.process, region); });
+			}
+		}
+		pool.Wait();
+		const Clock::time_point start = Clock::now();
+		memory_scanner::NextScanAll<int32_t>(pool, targets,
+			[](const int32_t &prev, const int32_t &current) -> bool { return current != prev; });
+		const double seconds = SecondsSince(start);
+		std::cout << "  " << config.name << ": " << (total_bytes / seconds / (1 << 30)) << " GiB/s" << std::endl;
+	}
+}
+
+void BenchSparse(std::vector<int32_t> &buffer)
+{
+	std::cout << "sparse:" << std::endl;
+	const HANDLE self = GetCurrentProcess();
+	const auto begin = reinterpret_cast<memory_scanner::IntPtr>(buffer.data());
+	const memory_scanner::IntPtr end = begin + buffer.size() * sizeof(int32_t);
+	std::vector<memory_scanner::MemoryRegion> regions = memory_scanner::QueryRegions(self, begin, end);
+	for (memory_scanner::MemoryRegion &region : regions) {
+		memory_scanner::ReadRegionData(self, region);
+	}
+	const memory_scanner::ScanTuning untuned{ .prefetch_distance = 0, .sparse_bytes_per_candidate = 0 };
+	const memory_scanner::ScanTuning tuned;
+	for (size_t stride = 4; stride <= (size_t(1) << 20); stride *= 16) {
+		std::vector<memory_scanner::IntPtr> candidates;
+		for (size_t i = 0; i < buffer.size(); i += stride) {
+			candidates.push_back(begin + i * sizeof(int32_t));
+		}
+		std::cout << "  1 in " << stride << " (" << candidates.size() << " candidates):";
+		for (const memory_scanner::ScanTuning &tuning : { untuned, tuned }) {
+			// Nothing changes between scans so every candidate and region survives and can be scanned again.
+			const Clock::time_point start = Clock::now();
+			memory_scanner::NextScan<int32_t>(self, regions, candidates,
+				[](const int32_t &prev, const int32_t &current) -> bool { return current == prev; }, tuning);
+			std::cout << " " << (SecondsSince(start) * 1000) << " ms";
+		}
+		std::cout << std::endl;
+	}
+}
+
+template<typename T>
+double ScanGiBPerSecond(std::vector<int32_t> &buffer)
+{
+	const HANDLE self = GetCurrentProcess();
+	const auto begin = reinterpret_cast<memory_scanner::IntPtr>(buffer.data());
+	const memory_scanner::IntPtr end = begin + buffer.size() * sizeof(int32_t);
+	std::vector<memory_scanner::MemoryRegion> regions = memory_scanner::QueryRegions(self, begin, end);
+	memory_scanner::IntPtr total_bytes = 0;
+	for (memory_scanner::MemoryRegion &region : regions) {
+		total_bytes += region.length;
+		memory_scanner::ReadRegionData(self, region);
+	}
+	const Clock::time_point start = Clock::now();
+	memory_scanner::NextScan<T>(self, regions, memory_scanner::filters::Increased());
+	return total_bytes / SecondsSince(start) / (1 << 30);
+}
+
+void BenchByteOrder(std::vector<int32_t> &buffer)
+{
+	std::cout << "byte order:" << std::endl;
+	std::cout << "  native: " << ScanGiBPerSecond<int32_t>(buffer) << " GiB/s" << std::endl;
+	std::cout << "  big-endian: " << ScanGiBPerSecond<memory_scanner::BigEndian<int32_t>>(buffer) << " GiB/s"
+			  << std::endl;
+}
+
+void Run()
+{
+	std::mt19937 rng(1);
+	std::vector<std::vector<int32_t>> buffers(num_targets, std::vector<int32_t>(values_per_target));
+	for (std::vector<int32_t> &buffer : buffers) {
+		for (int32_t &value : buffer) {
+			value = static_cast<int32_t>(rng());
+		}
+	}
+	BenchNuma(buffers);
+	BenchSparse(buffers[0]);
+	BenchByteOrder(buffers[0]);
+}
+
+}  // namespace
+
+int main()
+{
+	static_assert(sizeof(void *) == 8, "You need to compile in 64 bit mode");
+
+	try {
+		Run();
+	} catch (memory_scanner::MemoryScannerException &e) {
+		std::cout << "\nFATAL" << std::endl;
+		std::cout << e.message << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "filter_combinators.hpp"
+#include "memory_scanner.hpp"
+#include "scan_types.hpp"
+
+namespace memory_scanner
+{
+
+// An address whose value changed, and which of its bits did.
+template<typename T>
+class BitChange
+{
+public:
+	IntPtr address;
+	// The bits that differ between the previous and current value, limited to the mask of the scan.
+	Scalar<T> changed_bits;
+};
+
+// Same as `NextScan<T>` with `filters::BitsFlipped(mask)`, but also reports for every address which bits changed, so
+// finding a flag does not need dumping memory and diffing it by hand. T must be an integer type or a byte-swapped one.
+template<typename T>
+std::vector<BitChange<T>> ChangedBitsScan(HANDLE process, std::vector<MemoryRegion> &regions,
+	Scalar<T> mask = static_cast<Scalar<T>>(~Scalar<T>(0)));
+
+//
+// Implementations of templated functions below...
+//
+
+template<typename T>
+std::vector<BitChange<T>> ChangedBitsScan(HANDLE process, std::vector<MemoryRegion> &regions, const Scalar<T> mask)
+{
+	static_assert(std::is_integral_v<Scalar<T>>, "Bits can only be compared for integer types");
+	std::vector<BitChange<T>> changes;
+	const filters::BitsFlipped<Scalar<T>> keep_if(mask);
+	size_t new_size_r = 0;
+	for (size_t r = 0; r < regions.size(); ++r) {
+		const bool keep = ScanRegionMatches<T>(process, regions[r], keep_if,
+			[&changes, mask](const IntPtr address, const T &prev, const T &cur) {
+				const auto changed = static_cast<Scalar<T>>((LoadScalar(prev) ^ LoadScalar(cur)) & mask);
+				changes.push_back(BitChange<T>{ address, changed });
+			});
+		if (keep) {
+			if (new_size_r != r) {
+				std::swap(regions[new_size_r], regions[r]);
+			}
+			++new_size_r;
+		}
+	}
+	regions.resize(new_size_r);
+	return changes;
+}
+
+}  // namespace memory_scanner
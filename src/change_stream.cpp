@@ -0,0 +1,99 @@
+#include "change_stream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+
+ChangeStream::ChangeStream(const ChangeStreamOptions &options) : options(options)
+{
+	if (options.capacity == 0 || options.max_batch == 0) {
+		throw MemoryScannerException("Change stream capacity and batch size must be positive");
+	}
+}
+
+void ChangeStream::PopFront()
+{
+	const auto it = newest.find(queue.front().address);
+	if (it != newest.end() && it->second == front_sequence) {
+		newest.erase(it);
+	}
+	queue.pop_front();
+	++front_sequence;
+}
+
+void ChangeStream::Publish(const ValueChange &change)
+{
+	{
+		const std::lock_guard lock(mutex);
+		++stats.published;
+		if (closed) {
+			++stats.dropped;
+			return;
+		}
+		if (queue.size() >= options.capacity) {
+			if (options.policy == OverflowPolicy::DropNewest) {
+				++stats.dropped;
+				return;
+			}
+			if (options.policy == OverflowPolicy::Coalesce) {
+				const auto it = newest.find(change.address);
+				if (it != newest.end()) {
+					ValueChange &queued = queue[it->second - front_sequence];
+					queued.new_value = change.new_value;
+					queued.time = change.time;
+					++stats.coalesced;
+					return;
+				}
+			}
+			PopFront();
+			++stats.dropped;
+		}
+		newest[change.address] = front_sequence + queue.size();
+		queue.push_back(change);
+	}
+	available.notify_one();
+}
+
+bool ChangeStream::NextBatch(std::vector<ValueChange> &batch, const std::chrono::milliseconds timeout)
+{
+	batch.clear();
+	std::unique_lock lock(mutex);
+	available.wait_for(lock, timeout, [this] { return !queue.empty() || closed; });
+	const size_t count = std::min(queue.size(), options.max_batch);
+	for (size_t i = 0; i < count; ++i) {
+		batch.push_back(queue.front());
+		PopFront();
+	}
+	stats.delivered += count;
+	return !(closed && batch.empty());
+}
+
+void ChangeStream::Close()
+{
+	{
+		const std::lock_guard lock(mutex);
+		closed = true;
+	}
+	available.notify_all();
+}
+
+ChangeStreamStats ChangeStream::Stats() const
+{
+	const std::lock_guard lock(mutex);
+	return stats;
+}
+
+AddressWatcher::ChangeFn PublishTo(ChangeStream &stream)
+{
+	return [&stream](const ValueChange &change) { stream.Publish(change); };
+}
+
+}  // namespace memory_scanner
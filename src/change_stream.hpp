@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "address_watcher.hpp"
+#include "memory_scanner.hpp"
+
+namespace memory_scanner
+{
+
+// What `ChangeStream::Publish` does when the queue is full.
+enum class OverflowPolicy : std::uint8_t {
+	// Discard the change being published.
+	DropNewest,
+	// Discard the oldest queued change to make room.
+	DropOldest,
+	// Merge the change into the queued change of the same address, keeping the queued old value and the new value and
+	// time. Falls back to DropOldest when the address has nothing queued.
+	Coalesce,
+};
+
+class ChangeStreamOptions
+{
+public:
+	size_t capacity = 4096;
+	// The most changes a single NextBatch hands out.
+	size_t max_batch = 256;
+	OverflowPolicy policy = OverflowPolicy::Coalesce;
+};
+
+class ChangeStreamStats
+{
+public:
+	std::uint64_t published = 0;
+	std::uint64_t delivered = 0;
+	std::uint64_t dropped = 0;
+	std::uint64_t coalesced = 0;
+};
+
+// A bounded queue carrying ValueChanges from whatever polls memory to a consumer, for example a telemetry pipeline.
+// Publishing never waits for the consumer: once the queue is full the overflow policy decides what is lost, so a slow
+// consumer never stalls polling. Safe to use from one producer and one or more consumers.
+class ChangeStream
+{
+public:
+	explicit ChangeStream(const ChangeStreamOptions &options = ChangeStreamOptions());
+
+	void Publish(const ValueChange &change);
+
+	// Waits up to `timeout` for a change, then replaces the contents of `batch` with up to `max_batch` changes, oldest
+	// first. Returns false, with `batch` empty, once the stream is closed and drained.
+	bool NextBatch(std::vector<ValueChange> &batch, std::chrono::milliseconds timeout);
+
+	// Wakes up consumers. Changes published afterwards are dropped, the queued ones can still be taken.
+	void Close();
+
+	ChangeStreamStats Stats() const;
+
+private:
+	void PopFront();
+
+	const ChangeStreamOptions options;
+	mutable std::mutex mutex;
+	std::condition_variable available;
+	std::deque<ValueChange> queue;
+	// Every queued change has a sequence number, `queue[i]` has `front_sequence + i`.
+	std::uint64_t front_sequence = 0;
+	// The sequence number of the newest queued change of each address, for coalescing.
+	std::unordered_map<IntPtr, std::uint64_t> newest;
+	ChangeStreamStats stats;
+	bool closed = false;
+};
+
+// Returns a callback for `AddressWatcher` that publishes every change to `stream`.
+AddressWatcher::ChangeFn PublishTo(ChangeStream &stream);
+
+}  // namespace memory_scanner
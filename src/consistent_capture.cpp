@@ -0,0 +1,171 @@
+#include "consistent_capture.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+#include <ProcessSnapshot.h>
+#include <TlHelp32.h>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+namespace
+{
+
+// NtSuspendProcess and NtResumeProcess, which the SDK does not declare, and RtlNtStatusToDosError to report their
+// failures.
+using NtProcessFn = LONG(NTAPI *)(HANDLE process);
+using NtStatusToErrorFn = ULONG(NTAPI *)(LONG status);
+
+class NtProcessFunctions
+{
+public:
+	NtProcessFn suspend = nullptr;
+	NtProcessFn resume = nullptr;
+	NtStatusToErrorFn status_to_error = nullptr;
+};
+
+const NtProcessFunctions &GetNtProcessFunctions()
+{
+	static const NtProcessFunctions functions = [] {
+		const HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
+		if (ntdll == nullptr) {
+			const DWORD ec = GetLastError();
+			throw MemoryScannerException("Cannot find ntdll.dll", ec);
+		}
+		NtProcessFunctions result;
+		result.suspend = reinterpret_cast<NtProcessFn>(GetProcAddress(ntdll, "NtSuspendProcess"));
+		result.resume = reinterpret_cast<NtProcessFn>(GetProcAddress(ntdll, "NtResumeProcess"));
+		result.status_to_error = reinterpret_cast<NtStatusToErrorFn>(GetProcAddress(ntdll, "RtlNtStatusToDosError"));
+		if (result.suspend == nullptr || result.resume == nullptr || result.status_to_error == nullptr) {
+			const DWORD ec = GetLastError();
+			throw MemoryScannerException("Cannot find the process suspend functions in ntdll.dll", ec);
+		}
+		return result;
+	}();
+	return functions;
+}
+
+// Counts the threads of `pid`.
+size_t CountThreads(const DWORD pid)
+{
+	const HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+	if (snapshot == INVALID_HANDLE_VALUE) {
+		const DWORD ec = GetLastError();
+		throw MemoryScannerException("Cannot snapshot threads", ec);
+	}
+	size_t count = 0;
+	THREADENTRY32 entry;
+	entry.dwSize = sizeof(entry);
+	for (BOOL ok = Thread32First(snapshot, &entry); ok; ok = Thread32Next(snapshot, &entry)) {
+		count += entry.th32OwnerProcessID == pid;
+	}
+	CloseHandle(snapshot);
+	return count;
+}
+
+// A single target holding the regions of `process` as `InitialScan` would read them, not read yet.
+std::vector<ScanTarget> QueryTarget(HANDLE process, const InitialScanOptions &options)
+{
+	std::vector<ScanTarget> targets(1);
+	targets[0].process = process;
+	targets[0].regions = QueryRegions(process, 0, ~IntPtr(0));
+	CoalesceRegions(targets[0].regions, options.max_span_length);
+	SetBoundaryOverlaps(targets[0].regions, options.boundary_overlap);
+	return targets;
+}
+
+}  // namespace
+
+ProcessFreeze::ProcessFreeze(HANDLE process) : process(process)
+{
+	const DWORD pid = GetProcessId(process);
+	if (pid == 0) {
+		const DWORD ec = GetLastError();
+		throw MemoryScannerException("Cannot get process id from handle", ec);
+	}
+	if (pid == GetCurrentProcessId()) {
+		throw MemoryScannerException("Cannot freeze the calling process");
+	}
+	const NtProcessFunctions &nt = GetNtProcessFunctions();
+	// Counted beforehand, since a system-wide snapshot would lengthen the pause.
+	thread_count = CountThreads(pid);
+	frozen_at = Clock::now();
+	const LONG status = nt.suspend(process);
+	if (status < 0) {
+		resumed = true;
+		throw MemoryScannerException("Cannot suspend process", nt.status_to_error(status));
+	}
+}
+
+ProcessFreeze::~ProcessFreeze()
+{
+	Resume();
+}
+
+ProcessFreeze::Clock::duration ProcessFreeze::Resume()
+{
+	if (resumed) {
+		return frozen_for;
+	}
+	resumed = true;
+	GetNtProcessFunctions().resume(process);
+	frozen_for = Clock::now() - frozen_at;
+	return frozen_for;
+}
+
+ProcessClone::ProcessClone(HANDLE process)
+{
+	const auto start = ProcessFreeze::Clock::now();
+	const DWORD ec = PssCaptureSnapshot(process, PSS_CAPTURE_VA_CLONE, 0, &snapshot);
+	capture_time = ProcessFreeze::Clock::now() - start;
+	if (ec != ERROR_SUCCESS) {
+		throw MemoryScannerException("Cannot capture process snapshot", ec);
+	}
+	PSS_VA_CLONE_INFORMATION info;
+	const DWORD query_ec = PssQuerySnapshot(snapshot, PSS_QUERY_VA_CLONE_INFORMATION, &info, sizeof(info));
+	if (query_ec != ERROR_SUCCESS) {
+		PssFreeSnapshot(GetCurrentProcess(), snapshot);
+		throw MemoryScannerException("Cannot query process snapshot", query_ec);
+	}
+	clone = info.VaCloneHandle;
+}
+
+ProcessClone::~ProcessClone()
+{
+	PssFreeSnapshot(GetCurrentProcess(), snapshot);
+}
+
+ConsistentCapture ConsistentInitialScan(WorkStealingPool &pool, HANDLE process, const InitialScanOptions &options,
+	const IntPtr bytes_per_task)
+{
+	std::vector<ScanTarget> targets = QueryTarget(process, options);
+	ConsistentCapture capture;
+	{
+		ProcessFreeze freeze(process);
+		capture.threads_suspended = freeze.ThreadCount();
+		ReadTargetSpans(pool, targets, bytes_per_task);
+		capture.pause = freeze.Resume();
+	}
+	capture.regions = std::move(targets[0].regions);
+	return capture;
+}
+
+ConsistentCapture CloneInitialScan(WorkStealingPool &pool, HANDLE process, const InitialScanOptions &options,
+	const IntPtr bytes_per_task)
+{
+	const ProcessClone clone(process);
+	std::vector<ScanTarget> targets = QueryTarget(clone.Handle(), options);
+	ReadTargetSpans(pool, targets, bytes_per_task);
+	ConsistentCapture capture;
+	capture.regions = std::move(targets[0].regions);
+	capture.pause = clone.CaptureTime();
+	return capture;
+}
+
+}  // namespace memory_scanner
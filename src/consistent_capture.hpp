@@ -0,0 +1,99 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+#include <ProcessSnapshot.h>
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "memory_scanner.hpp"
+#include "multi_target_scan.hpp"
+#include "thread_pool.hpp"
+
+namespace memory_scanner
+{
+
+// Suspends every thread of a process for as long as it lives, all at once with NtSuspendProcess, so threads cannot
+// start or resume each other while the freeze is set up.
+class ProcessFreeze
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// `process` must not be the calling process, needs PROCESS_SUSPEND_RESUME access and must outlive the freeze.
+	explicit ProcessFreeze(HANDLE process);
+	~ProcessFreeze();
+
+	ProcessFreeze(const ProcessFreeze &) = delete;
+	ProcessFreeze &operator=(const ProcessFreeze &) = delete;
+
+	// Resumes the process early. Returns how long it was frozen. Does nothing and returns the same duration when
+	// called again.
+	Clock::duration Resume();
+
+	// The number of threads the process had just before it was frozen.
+	size_t ThreadCount() const { return thread_count; }
+
+private:
+	HANDLE process;
+	size_t thread_count = 0;
+	Clock::time_point frozen_at;
+	Clock::duration frozen_for{};
+	bool resumed = false;
+};
+
+// A copy-on-write clone of the address space of a process, made with PssCaptureSnapshot. The process is only paused
+// while the clone is set up, after which it keeps running and its writes no longer show up in the clone. Reading the
+// clone through `Handle()` gives a point-in-time view of the process at the same addresses. The clone is freed along
+// with this object.
+class ProcessClone
+{
+public:
+	// `process` needs PROCESS_CREATE_PROCESS, PROCESS_QUERY_INFORMATION and PROCESS_VM_READ access.
+	explicit ProcessClone(HANDLE process);
+	~ProcessClone();
+
+	ProcessClone(const ProcessClone &) = delete;
+	ProcessClone &operator=(const ProcessClone &) = delete;
+
+	// A handle to the clone usable with `ReadMemory`, `QueryRegions` and the like.
+	HANDLE Handle() const { return clone; }
+
+	// How long setting up the clone took, which bounds how long the process was paused.
+	ProcessFreeze::Clock::duration CaptureTime() const { return capture_time; }
+
+private:
+	HPSS snapshot = nullptr;
+	HANDLE clone = nullptr;
+	ProcessFreeze::Clock::duration capture_time{};
+};
+
+// A snapshot of a process in which every region was read at the same moment.
+class ConsistentCapture
+{
+public:
+	std::vector<MemoryRegion> regions;
+	// How long the process was frozen.
+	ProcessFreeze::Clock::duration pause{};
+	// The number of threads the process had just before it was frozen. 0 for `CloneInitialScan`, which leaves the
+	// suspending to PssCaptureSnapshot.
+	size_t threads_suspended = 0;
+};
+
+// Same as `InitialScan`, but the process is frozen while its regions are read, so relational filters never compare
+// values from different moments. To keep the pause short the regions are queried before the freeze, and they are read
+// in parallel by the workers of `pool` like `InitialScanAll`. Regions freed or re-protected in between are handled
+// like by `ReadSpan`.
+ConsistentCapture ConsistentInitialScan(WorkStealingPool &pool, HANDLE process,
+	const InitialScanOptions &options = InitialScanOptions(), IntPtr bytes_per_task = default_bytes_per_task);
+
+// Same as above, but reads a `ProcessClone` of the process instead of freezing it, so the pause is only as long as
+// setting up the clone, however much memory is read. The regions have the addresses of the process, so `NextScan` on
+// `process` works on them unchanged.
+ConsistentCapture CloneInitialScan(WorkStealingPool &pool, HANDLE process,
+	const InitialScanOptions &options = InitialScanOptions(), IntPtr bytes_per_task = default_bytes_per_task);
+
+}  // namespace memory_scanner
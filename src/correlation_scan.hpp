@@ -0,0 +1,98 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "memory_scanner.hpp"
+#include "module_map.hpp"
+#include "scan_kernels.hpp"
+
+namespace memory_scanner
+{
+
+// Keeps values that are the same in both processes.
+template<typename T>
+class EqualAcross
+{
+public:
+	bool operator()(const T &a, const T &b) const { return a == b; }
+};
+
+// Keeps values where the second process holds the value of the first process plus `delta`.
+template<typename T>
+class DiffersBy
+{
+public:
+	T delta;
+
+	bool operator()(const T &a, const T &b) const { return static_cast<T>(a + delta) == b; }
+};
+
+// The offsets found by `CorrelationScan`, along with the modules they are relative to.
+class CorrelationResult
+{
+public:
+	// The modules of the first process as listed by `EnumerateModules`, which `ModuleOffset::module_index` refers to.
+	std::vector<ModuleInfo> modules;
+	// Sorted by module and then offset.
+	std::vector<ModuleOffset> offsets;
+};
+
+// Compares two processes running the same executable. For every module loaded in both, the R/W regions of the module
+// in `process_a` are read together with the same offsets of the module in `process_b` and `pred(value_a, value_b)` is
+// applied to each pair of values. The offsets that pass are returned relative to the modules of `process_a`. Memory
+// outside of modules (heaps, stacks) is not compared since its layout is not shared between processes.
+template<typename T, typename Pred>
+CorrelationResult CorrelationScan(HANDLE process_a, HANDLE process_b, const Pred &pred);
+
+//
+// Implementations of templated functions below...
+//
+
+template<typename T, typename Pred>
+CorrelationResult CorrelationScan(HANDLE process_a, HANDLE process_b, const Pred &pred)
+{
+	CorrelationResult result;
+	result.modules = EnumerateModules(process_a);
+	const std::vector<ModuleInfo> &modules_a = result.modules;
+	const std::vector<ModuleInfo> modules_b = EnumerateModules(process_b);
+	std::vector<ModuleOffset> &offsets = result.offsets;
+	for (size_t m = 0; m < modules_a.size(); ++m) {
+		const ModuleInfo &module_a = modules_a[m];
+		const size_t found = FindModuleByName(modules_b, module_a.name);
+		// A different size means a different build of the module, so the offsets would not line up.
+		if (found == modules_b.size() || modules_b[found].length != module_a.length) {
+			continue;
+		}
+		const ModuleInfo &module_b = modules_b[found];
+		std::vector<MemoryRegion> regions_a =
+			QueryRegions(process_a, module_a.base_address, module_a.base_address + module_a.length);
+		for (MemoryRegion &region_a : regions_a) {
+			const IntPtr offset = region_a.base_address - module_a.base_address;
+			MemoryRegion region_b;
+			region_b.base_address = module_b.base_address + offset;
+			region_b.length = region_a.length;
+			const SIZE_T bytes_read_a = ReadRegionData(process_a, region_a);
+			const SIZE_T bytes_read_b = ReadRegionData(process_b, region_b);
+			const T *const ptr_a = reinterpret_cast<const T *>(region_a.data.get());
+			const T *const ptr_b = reinterpret_cast<const T *>(region_b.data.get());
+			// Only compare what could be read from both.
+			const size_t count = std::min(bytes_read_a, bytes_read_b) / sizeof(T);
+			ForEachMatch(ptr_a, ptr_b, count, pred, [&](const size_t i) {
+				offsets.push_back(ModuleOffset{
+					.module_index = static_cast<std::uint32_t>(m),
+					.offset = offset + (i * sizeof(T)),
+				});
+			});
+		}
+	}
+	return result;
+}
+
+}  // namespace memory_scanner
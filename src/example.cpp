@@ -7,13 +7,20 @@
 #include <Windows.h>
 #include <Winuser.h>
 
+#include <atomic>
 #include <charconv>
+#include <chrono>
 #include <cstdint>
+#include <exception>
 #include <iostream>
 #include <ostream>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
+#include "address_watcher.hpp"
+#include "change_stream.hpp"
 #include "memory_scanner.hpp"
 #include "memory_scanner_exception.hpp"
 
@@ -152,16 +159,34 @@ void ContinuouslyReadMemoryAddress(HANDLE process, memory_scanner::IntPtr addres
 	memory_scanner::MemoryObject<T> object;
 	object.address = address;
 	object.ReRead(process);
-	T last_value = object.value;
-	std::cout << last_value << std::endl;
-	for (;;) {
-		Sleep(100);
-		object.ReRead(process);
-		if (object.value != last_value) {
-			std::cout << object.value << std::endl;
-			last_value = object.value;
+	std::cout << object.value << std::endl;
+	// Polls quickly while the value keeps changing and backs off while it does not. The watcher runs on its own thread
+	// and hands the changes over through a stream, so printing never holds up polling.
+	memory_scanner::ChangeStream stream;
+	std::atomic<bool> stop = false;
+	std::exception_ptr poller_error = nullptr;
+	std::thread poller([process, address, &stream, &stop, &poller_error] {
+		try {
+			memory_scanner::AddressWatcher watcher(process);
+			watcher.Watch(address, sizeof(T));
+			watcher.Run(memory_scanner::PublishTo(stream), [&stop] { return !stop; });
+		} catch (...) {
+			poller_error = std::current_exception();
+		}
+		// Ends the loop below once the queued changes are printed.
+		stream.Close();
+	});
+	std::vector<memory_scanner::ValueChange> batch;
+	while (stream.NextBatch(batch, std::chrono::milliseconds(1000))) {
+		for (const memory_scanner::ValueChange &change : batch) {
+			std::cout << memory_scanner::ValueAs<T>(change.new_value) << std::endl;
 		}
 	}
+	stop = true;
+	poller.join();
+	if (poller_error != nullptr) {
+		std::rethrow_exception(poller_error);
+	}
 }
 
 void Run()
@@ -0,0 +1,464 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include "scan_types.hpp"
+
+// Filters built from small clauses, for example `Changed() && InRange(0, 1000)`. Combining clauses with `&&`, `||` and
+// `!` produces a single function object whose type describes the whole filter, so the scan kernels inline all of it
+// into one loop instead of making an indirect call per clause. Pass the result straight to `NextScan` or `NextScanAll`.
+//
+// Every clause has a `cost`. `&&` and `||` evaluate the cheaper side first, and when every clause is a plain comparison
+// both sides are evaluated without branching so the loop can be vectorized.
+namespace memory_scanner::filters
+{
+
+// The base of every clause, which opts it into the operators below.
+template<typename Derived>
+class Clause
+{
+public:
+	// Clauses look at values only through LoadScalar, see `LoadsScalars`.
+	static constexpr bool loads_scalars = true;
+};
+
+template<typename E>
+concept ClauseExpression = std::is_base_of_v<Clause<E>, E>;
+
+// The current value differs from the previous one.
+class Changed : public Clause<Changed>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		return LoadScalar(cur) != LoadScalar(prev);
+	}
+};
+
+// The current value is the same as the previous one.
+class Unchanged : public Clause<Unchanged>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		return LoadScalar(cur) == LoadScalar(prev);
+	}
+};
+
+// The current value is greater than the previous one.
+class Increased : public Clause<Increased>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		return LoadScalar(cur) > LoadScalar(prev);
+	}
+};
+
+// The current value is less than the previous one.
+class Decreased : public Clause<Decreased>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		return LoadScalar(cur) < LoadScalar(prev);
+	}
+};
+
+// The current value equals `value`.
+template<typename V>
+class Equals : public Clause<Equals<V>>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	explicit Equals(const V value) : value(value) {}
+
+	template<typename T>
+	bool operator()(const T &, const T &cur) const
+	{
+		return LoadScalar(cur) == static_cast<Scalar<T>>(value);
+	}
+
+	V value;
+};
+
+// The current value lies within [low, high].
+template<typename V>
+class InRange : public Clause<InRange<V>>
+{
+public:
+	static constexpr int cost = 2;
+	static constexpr bool branch_free = true;
+
+	InRange(const V low, const V high) : low(low), high(high) {}
+
+	template<typename T>
+	bool operator()(const T &, const T &cur) const
+	{
+		const Scalar<T> value = LoadScalar(cur);
+		return (value >= static_cast<Scalar<T>>(low)) & (value <= static_cast<Scalar<T>>(high));
+	}
+
+	V low;
+	V high;
+};
+
+// The bits of the current value selected by `mask` equal `value`.
+template<typename V>
+class MaskEquals : public Clause<MaskEquals<V>>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	MaskEquals(const V mask, const V value) : mask(mask), value(value) {}
+
+	template<typename T>
+	bool operator()(const T &, const T &cur) const
+	{
+		using S = Scalar<T>;
+		return static_cast<S>(LoadScalar(cur) & static_cast<S>(mask)) == static_cast<S>(value);
+	}
+
+	V mask;
+	V value;
+};
+
+// Every bit of `mask` is set in the current value.
+template<typename V>
+class BitsSet : public Clause<BitsSet<V>>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	explicit BitsSet(const V mask) : mask(mask) {}
+
+	template<typename T>
+	bool operator()(const T &, const T &cur) const
+	{
+		using S = Scalar<T>;
+		return static_cast<S>(LoadScalar(cur) & static_cast<S>(mask)) == static_cast<S>(mask);
+	}
+
+	V mask;
+};
+
+// Every bit of `mask` is clear in the current value.
+template<typename V>
+class BitsCleared : public Clause<BitsCleared<V>>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	explicit BitsCleared(const V mask) : mask(mask) {}
+
+	template<typename T>
+	bool operator()(const T &, const T &cur) const
+	{
+		using S = Scalar<T>;
+		return static_cast<S>(LoadScalar(cur) & static_cast<S>(mask)) == 0;
+	}
+
+	V mask;
+};
+
+// At least one bit of `mask` differs between the previous and current value.
+template<typename V>
+class BitsFlipped : public Clause<BitsFlipped<V>>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	explicit BitsFlipped(const V mask) : mask(mask) {}
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		using S = Scalar<T>;
+		return static_cast<S>((LoadScalar(cur) ^ LoadScalar(prev)) & static_cast<S>(mask)) != 0;
+	}
+
+	V mask;
+};
+
+// At least one bit of `mask` was clear in the previous value and is set in the current one.
+template<typename V>
+class BitsRose : public Clause<BitsRose<V>>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	explicit BitsRose(const V mask) : mask(mask) {}
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		using S = Scalar<T>;
+		return static_cast<S>(LoadScalar(cur) & ~LoadScalar(prev) & static_cast<S>(mask)) != 0;
+	}
+
+	V mask;
+};
+
+// At least one bit of `mask` was set in the previous value and is clear in the current one.
+template<typename V>
+class BitsFell : public Clause<BitsFell<V>>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	explicit BitsFell(const V mask) : mask(mask) {}
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		using S = Scalar<T>;
+		return static_cast<S>(LoadScalar(prev) & ~LoadScalar(cur) & static_cast<S>(mask)) != 0;
+	}
+
+	V mask;
+};
+
+namespace internal
+{
+
+// Converts integers to their unsigned type so arithmetic on them wraps instead of overflowing.
+template<typename S>
+std::make_unsigned_t<S> Unsigned(const S value)
+{
+	static_assert(std::is_integral_v<S>, "Only integer types can be decoded");
+	return static_cast<std::make_unsigned_t<S>>(value);
+}
+
+}  // namespace internal
+
+// Values stored XOR'd with an unknown key: the value went from `old_value` to `new_value`. XOR'ing the previous and
+// current value cancels the key, so this holds whatever the key is.
+template<typename V>
+class XorChangedBy : public Clause<XorChangedBy<V>>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	XorChangedBy(const V old_value, const V new_value) : old_value(old_value), new_value(new_value) {}
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		using S = Scalar<T>;
+		return (internal::Unsigned(LoadScalar(cur)) ^ internal::Unsigned(LoadScalar(prev))) ==
+			(internal::Unsigned(static_cast<S>(new_value)) ^ internal::Unsigned(static_cast<S>(old_value)));
+	}
+
+	V old_value;
+	V new_value;
+};
+
+// Values stored offset by an unknown key: the value went from `old_value` to `new_value`. Subtracting the previous from
+// the current value cancels the key, so this holds whatever the key is.
+template<typename V>
+class AddChangedBy : public Clause<AddChangedBy<V>>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	AddChangedBy(const V old_value, const V new_value) : old_value(old_value), new_value(new_value) {}
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		using S = Scalar<T>;
+		using U = std::make_unsigned_t<S>;
+		return static_cast<U>(internal::Unsigned(LoadScalar(cur)) - internal::Unsigned(LoadScalar(prev))) ==
+			static_cast<U>(internal::Unsigned(static_cast<S>(new_value)) - internal::Unsigned(static_cast<S>(old_value)));
+	}
+
+	V old_value;
+	V new_value;
+};
+
+// The current value is `value` XOR'd with some key that only uses the bits of `key_mask`, e.g. 0xff for any 8 bit key.
+// This tries every such key with a single comparison instead of one scan per key.
+template<typename V>
+class XorKeyIn : public Clause<XorKeyIn<V>>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	XorKeyIn(const V value, const V key_mask) : value(value), key_mask(key_mask) {}
+
+	template<typename T>
+	bool operator()(const T &, const T &cur) const
+	{
+		using S = Scalar<T>;
+		using U = std::make_unsigned_t<S>;
+		const U key = internal::Unsigned(LoadScalar(cur)) ^ internal::Unsigned(static_cast<S>(value));
+		return static_cast<U>(key & ~internal::Unsigned(static_cast<S>(key_mask))) == 0;
+	}
+
+	V value;
+	V key_mask;
+};
+
+// The current value is `value` plus some key in [0, max_key]. This tries every such key with a single comparison
+// instead of one scan per key.
+template<typename V>
+class AddKeyIn : public Clause<AddKeyIn<V>>
+{
+public:
+	static constexpr int cost = 1;
+	static constexpr bool branch_free = true;
+
+	AddKeyIn(const V value, const V max_key) : value(value), max_key(max_key) {}
+
+	template<typename T>
+	bool operator()(const T &, const T &cur) const
+	{
+		using S = Scalar<T>;
+		using U = std::make_unsigned_t<S>;
+		const U key = internal::Unsigned(LoadScalar(cur)) - internal::Unsigned(static_cast<S>(value));
+		return static_cast<U>(key) <= internal::Unsigned(static_cast<S>(max_key));
+	}
+
+	V value;
+	V max_key;
+};
+
+// Any callable taking the previous and current value, for conditions the clauses above cannot express. It is assumed to
+// be expensive and is never evaluated unless the cheaper side of `&&` or `||` leaves the result open.
+template<typename Fn>
+class Where : public Clause<Where<Fn>>
+{
+public:
+	static constexpr int cost = 16;
+	static constexpr bool branch_free = false;
+	static constexpr bool loads_scalars = false;
+
+	explicit Where(Fn fn) : fn(std::move(fn)) {}
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		return fn(prev, cur);
+	}
+
+	Fn fn;
+};
+
+template<typename L, typename R>
+class And : public Clause<And<L, R>>
+{
+public:
+	static constexpr int cost = L::cost + R::cost;
+	static constexpr bool branch_free = L::branch_free && R::branch_free;
+	static constexpr bool loads_scalars = L::loads_scalars && R::loads_scalars;
+
+	And(L lhs, R rhs) : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		if constexpr (branch_free) {
+			return lhs(prev, cur) & rhs(prev, cur);
+		} else if constexpr (R::cost < L::cost) {
+			return rhs(prev, cur) && lhs(prev, cur);
+		} else {
+			return lhs(prev, cur) && rhs(prev, cur);
+		}
+	}
+
+	L lhs;
+	R rhs;
+};
+
+template<typename L, typename R>
+class Or : public Clause<Or<L, R>>
+{
+public:
+	static constexpr int cost = L::cost + R::cost;
+	static constexpr bool branch_free = L::branch_free && R::branch_free;
+	static constexpr bool loads_scalars = L::loads_scalars && R::loads_scalars;
+
+	Or(L lhs, R rhs) : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		if constexpr (branch_free) {
+			return lhs(prev, cur) | rhs(prev, cur);
+		} else if constexpr (R::cost < L::cost) {
+			return rhs(prev, cur) || lhs(prev, cur);
+		} else {
+			return lhs(prev, cur) || rhs(prev, cur);
+		}
+	}
+
+	L lhs;
+	R rhs;
+};
+
+template<typename E>
+class Not : public Clause<Not<E>>
+{
+public:
+	static constexpr int cost = E::cost;
+	static constexpr bool branch_free = E::branch_free;
+	static constexpr bool loads_scalars = E::loads_scalars;
+
+	explicit Not(E inner) : inner(std::move(inner)) {}
+
+	template<typename T>
+	bool operator()(const T &prev, const T &cur) const
+	{
+		return !inner(prev, cur);
+	}
+
+	E inner;
+};
+
+template<ClauseExpression L, ClauseExpression R>
+And<L, R> operator&&(L lhs, R rhs)
+{
+	return And<L, R>(std::move(lhs), std::move(rhs));
+}
+
+template<ClauseExpression L, ClauseExpression R>
+Or<L, R> operator||(L lhs, R rhs)
+{
+	return Or<L, R>(std::move(lhs), std::move(rhs));
+}
+
+template<ClauseExpression E>
+Not<E> operator!(E inner)
+{
+	return Not<E>(std::move(inner));
+}
+
+}  // namespace memory_scanner::filters
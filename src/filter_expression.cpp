@@ -0,0 +1,307 @@
+#include "filter_expression.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+namespace
+{
+
+class Node
+{
+public:
+	enum class Kind { Prev, Cur, Constant, Unary, Binary };
+
+	Kind kind;
+	FilterOp op = FilterOp::Add;
+	// Children for operations, or the index into the constants.
+	size_t lhs = 0;
+	size_t rhs = 0;
+};
+
+class BinaryLevel
+{
+public:
+	std::string_view token;
+	FilterOp op;
+};
+
+// From lowest to highest precedence, each level holding the operators that bind equally tight. Longer tokens come
+// first so that `<=` is not read as `<`.
+const std::vector<std::vector<BinaryLevel>> binary_levels = {
+	{ { "||", FilterOp::LogicalOr } },
+	{ { "&&", FilterOp::LogicalAnd } },
+	{ { "|", FilterOp::BitOr } },
+	{ { "^", FilterOp::BitXor } },
+	{ { "&", FilterOp::BitAnd } },
+	{ { "==", FilterOp::Equal }, { "!=", FilterOp::NotEqual } },
+	{ { "<=", FilterOp::LessEqual }, { ">=", FilterOp::GreaterEqual }, { "<", FilterOp::Less },
+		{ ">", FilterOp::Greater } },
+	{ { "+", FilterOp::Add }, { "-", FilterOp::Subtract } },
+	{ { "*", FilterOp::Multiply }, { "/", FilterOp::Divide }, { "%", FilterOp::Remainder } },
+};
+
+// A recursive descent parser producing a tree of Nodes.
+class Parser
+{
+public:
+	explicit Parser(const std::string_view text) : text(text) {}
+
+	size_t ParseAll()
+	{
+		const size_t root = ParseLevel(0);
+		SkipSpace();
+		if (pos != text.size()) {
+			Fail("Unexpected character");
+		}
+		return root;
+	}
+
+	std::vector<Node> nodes;
+	std::vector<ScanValue> constants;
+
+private:
+	[[noreturn]] void Fail(const std::string_view message) const
+	{
+		throw MemoryScannerException(
+			std::string(message) + " at offset " + std::to_string(pos) + " of filter \"" + std::string(text) + "\"");
+	}
+
+	void SkipSpace()
+	{
+		while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+			++pos;
+		}
+	}
+
+	// Consumes `token` if it comes next, unless it is only the start of a longer operator such as `&` of `&&`.
+	bool Accept(const std::string_view token)
+	{
+		SkipSpace();
+		if (text.substr(pos, token.size()) != token) {
+			return false;
+		}
+		const char next = pos + token.size() < text.size() ? text[pos + token.size()] : '\0';
+		if (token.size() == 1 && (token[0] == '&' || token[0] == '|') && next == token[0]) {
+			return false;
+		}
+		if ((token == "<" || token == ">" || token == "!") && next == '=') {
+			return false;
+		}
+		pos += token.size();
+		return true;
+	}
+
+	size_t Add(const Node node)
+	{
+		nodes.push_back(node);
+		return nodes.size() - 1;
+	}
+
+	size_t ParseLevel(const size_t level)
+	{
+		if (level == binary_levels.size()) {
+			return ParseUnary();
+		}
+		size_t lhs = ParseLevel(level + 1);
+		for (;;) {
+			const auto it = std::find_if(binary_levels[level].begin(), binary_levels[level].end(),
+				[this](const BinaryLevel &candidate) { return Accept(candidate.token); });
+			if (it == binary_levels[level].end()) {
+				return lhs;
+			}
+			const size_t rhs = ParseLevel(level + 1);
+			lhs = Add(Node{ .kind = Node::Kind::Binary, .op = it->op, .lhs = lhs, .rhs = rhs });
+		}
+	}
+
+	size_t ParseUnary()
+	{
+		if (Accept("!")) {
+			const size_t operand = ParseUnary();
+			return Add(Node{ .kind = Node::Kind::Unary, .op = FilterOp::LogicalNot, .lhs = operand });
+		}
+		if (Accept("-")) {
+			const size_t operand = ParseUnary();
+			return Add(Node{ .kind = Node::Kind::Unary, .op = FilterOp::Negate, .lhs = operand });
+		}
+		return ParsePrimary();
+	}
+
+	size_t ParsePrimary()
+	{
+		SkipSpace();
+		if (Accept("(")) {
+			const size_t inner = ParseLevel(0);
+			if (!Accept(")")) {
+				Fail("Expected ')'");
+			}
+			return inner;
+		}
+		if (pos < text.size() && std::isalpha(static_cast<unsigned char>(text[pos]))) {
+			const size_t begin = pos;
+			while (pos < text.size() && std::isalnum(static_cast<unsigned char>(text[pos]))) {
+				++pos;
+			}
+			const std::string_view name = text.substr(begin, pos - begin);
+			if (name == "prev") {
+				return Add(Node{ .kind = Node::Kind::Prev });
+			}
+			if (name == "cur") {
+				return Add(Node{ .kind = Node::Kind::Cur });
+			}
+			pos = begin;
+			Fail("Unknown name");
+		}
+		return ParseNumber();
+	}
+
+	size_t ParseNumber()
+	{
+		const char *const begin = text.data() + pos;
+		const char *const end = text.data() + text.size();
+		ScanValue value;
+		std::from_chars_result result;
+		if (text.substr(pos, 2) == "0x" || text.substr(pos, 2) == "0X") {
+			result = std::from_chars(begin + 2, end, value.as_uint, 16);
+			value.as_int = static_cast<std::int64_t>(value.as_uint);
+			value.as_double = static_cast<double>(value.as_uint);
+		} else {
+			const char *integer_end = begin;
+			while (integer_end != end && std::isdigit(static_cast<unsigned char>(*integer_end))) {
+				++integer_end;
+			}
+			const bool is_float = integer_end != end && (*integer_end == '.' || *integer_end == 'e' ||
+				*integer_end == 'E');
+			if (is_float) {
+				result = std::from_chars(begin, end, value.as_double);
+				value.as_int = static_cast<std::int64_t>(value.as_double);
+				value.as_uint = static_cast<std::uint64_t>(value.as_int);
+			} else {
+				result = std::from_chars(begin, end, value.as_uint);
+				value.as_int = static_cast<std::int64_t>(value.as_uint);
+				value.as_double = static_cast<double>(value.as_uint);
+			}
+		}
+		if (result.ec != std::errc()) {
+			Fail("Expected a number");
+		}
+		pos = result.ptr - text.data();
+		constants.push_back(value);
+		return Add(Node{ .kind = Node::Kind::Constant, .lhs = constants.size() - 1 });
+	}
+
+	std::string_view text;
+	size_t pos = 0;
+};
+
+// Turns the tree into instructions. Temporaries are allocated like a stack: the result of a node goes into the first
+// free register and its children may use the registers from there on.
+class Compiler
+{
+public:
+	Compiler(const std::vector<Node> &nodes, const size_t constant_count)
+		: nodes(nodes), constant_count(constant_count), register_count(2 + constant_count)
+	{
+	}
+
+	std::uint8_t Compile(const size_t index, const size_t free)
+	{
+		const Node &node = nodes[index];
+		switch (node.kind) {
+		case Node::Kind::Prev:
+			return 0;
+		case Node::Kind::Cur:
+			return 1;
+		case Node::Kind::Constant:
+			return static_cast<std::uint8_t>(2 + node.lhs);
+		default:
+			break;
+		}
+		Use(free);
+		const std::uint8_t a = Compile(node.lhs, free);
+		std::uint8_t b = a;
+		if (node.kind == Node::Kind::Binary) {
+			b = Compile(node.rhs, a == free ? free + 1 : free);
+		}
+		const std::uint8_t dst = static_cast<std::uint8_t>(free);
+		instructions.push_back(FilterInstruction{ .op = node.op, .dst = dst, .a = a, .b = b });
+		return dst;
+	}
+
+	size_t FirstTemporary() const { return 2 + constant_count; }
+
+	const std::vector<Node> &nodes;
+	const size_t constant_count;
+	size_t register_count;
+	std::vector<FilterInstruction> instructions;
+
+private:
+	void Use(const size_t reg)
+	{
+		if (reg >= max_filter_registers) {
+			throw MemoryScannerException("Filter expression needs too many registers");
+		}
+		register_count = std::max(register_count, reg + 1);
+	}
+};
+
+}  // namespace
+
+FilterExpression FilterExpression::Parse(const std::string_view text)
+{
+	Parser parser(text);
+	const size_t root = parser.ParseAll();
+	if (2 + parser.constants.size() > max_filter_registers) {
+		throw MemoryScannerException("Filter expression has too many constants");
+	}
+	Compiler compiler(parser.nodes, parser.constants.size());
+	FilterExpression expression;
+	expression.result_register = compiler.Compile(root, compiler.FirstTemporary());
+	expression.instructions = std::move(compiler.instructions);
+	expression.constants = std::move(parser.constants);
+	expression.register_count = compiler.register_count;
+	return expression;
+}
+
+bool FilterExpression::UsesBitwise() const
+{
+	return std::any_of(instructions.begin(), instructions.end(), [](const FilterInstruction &instruction) {
+		return instruction.op == FilterOp::BitAnd || instruction.op == FilterOp::BitOr ||
+			instruction.op == FilterOp::BitXor;
+	});
+}
+
+std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions, const ScanType type,
+	const FilterExpression &expression)
+{
+	return VisitScanType(type, [&]<typename T>(std::type_identity<T>) {
+		return NextScan<T>(process, regions, FilterProgram<T>(expression));
+	});
+}
+
+void NextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses,
+	const ScanType type, const FilterExpression &expression, const ScanTuning &tuning)
+{
+	VisitScanType(type, [&]<typename T>(std::type_identity<T>) {
+		NextScan<T>(process, regions, valid_addresses, FilterProgram<T>(expression), tuning);
+	});
+}
+
+}  // namespace memory_scanner
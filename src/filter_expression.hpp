@@ -0,0 +1,355 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "memory_scanner.hpp"
+#include "memory_scanner_exception.hpp"
+#include "scan_kernels.hpp"
+#include "scan_types.hpp"
+#include "typed_scan.hpp"
+
+namespace memory_scanner
+{
+
+// The operations of the filter bytecode. Comparisons and logical operations produce 1 or 0.
+enum class FilterOp : std::uint8_t {
+	Add,
+	Subtract,
+	Multiply,
+	Divide,
+	Remainder,
+	BitAnd,
+	BitOr,
+	BitXor,
+	Equal,
+	NotEqual,
+	Less,
+	LessEqual,
+	Greater,
+	GreaterEqual,
+	LogicalAnd,
+	LogicalOr,
+	LogicalNot,
+	Negate,
+};
+
+// Computes `registers[dst] = registers[a] op registers[b]` for every lane. Unary operations ignore `b`.
+class FilterInstruction
+{
+public:
+	FilterOp op;
+	std::uint8_t dst;
+	std::uint8_t a;
+	std::uint8_t b;
+};
+
+// The most registers an expression may use, including `prev`, `cur` and the constants.
+constexpr size_t max_filter_registers = 32;
+
+// A filter typed at runtime, for example `cur > prev && cur - prev < 10 && cur % 5 == 0`. `prev` and `cur` are the
+// values from the previous and current scan. The operators are those of C++ with the same precedence: `|| && | ^ &`,
+// `== !=`, `< <= > >=`, `+ -`, `* / %` and unary `! -`. Constants are decimal, hexadecimal with `0x`, or floating
+// point.
+//
+// The text is compiled once into a register bytecode. Register 0 holds `prev`, register 1 `cur`, the constants follow
+// and the temporaries come last.
+class FilterExpression
+{
+public:
+	// Throws a MemoryScannerException pointing at the offending offset if the text is not a valid expression.
+	static FilterExpression Parse(std::string_view text);
+
+	const std::vector<FilterInstruction> &Instructions() const { return instructions; }
+	const std::vector<ScanValue> &Constants() const { return constants; }
+	std::uint8_t ResultRegister() const { return result_register; }
+	size_t RegisterCount() const { return register_count; }
+	// Whether the expression uses `&`, `|` or `^`, which only integer types support.
+	bool UsesBitwise() const;
+
+private:
+	std::vector<FilterInstruction> instructions;
+	std::vector<ScanValue> constants;
+	std::uint8_t result_register = 0;
+	size_t register_count = 0;
+};
+
+// A FilterExpression bound to the stored type T, usable as the filter of any scan. The kernels hand it 64 elements at
+// a time and every instruction runs as one tight loop over all of them, so the interpreter overhead is paid once per
+// block instead of once per element. Integer types are computed in 64 bits with wrapping arithmetic and floating point
+// types as double. Division or remainder by zero gives 0.
+template<typename T>
+class FilterProgram
+{
+public:
+	// Throws a MemoryScannerException if the expression cannot be evaluated for T.
+	explicit FilterProgram(const FilterExpression &expression);
+
+	std::uint64_t EvaluateBlock(const T *prev, const T *cur, size_t n) const;
+
+	// Evaluates a single pair one instruction at a time, for the scans that filter candidates one by one.
+	bool operator()(const T &prev, const T &cur) const;
+
+private:
+	using Value = std::conditional_t<std::is_floating_point_v<Scalar<T>>, double,
+		std::conditional_t<std::is_signed_v<Scalar<T>>, std::int64_t, std::uint64_t>>;
+
+	std::vector<FilterInstruction> instructions;
+	std::vector<Value> constants;
+	std::uint8_t result_register;
+};
+
+// Same as `NextScan<T>` with a `FilterProgram<T>`, for a type chosen at runtime.
+std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions, ScanType type,
+	const FilterExpression &expression);
+
+// Same as above, but restricted to `valid_addresses` like the restricted `NextScan<T>`.
+void NextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses, ScanType type,
+	const FilterExpression &expression, const ScanTuning &tuning = ScanTuning());
+
+//
+// Implementations of templated functions below...
+//
+
+namespace internal
+{
+
+template<typename V>
+V WrappingAdd(const V x, const V y)
+{
+	if constexpr (std::is_integral_v<V>) {
+		return static_cast<V>(static_cast<std::uint64_t>(x) + static_cast<std::uint64_t>(y));
+	} else {
+		return x + y;
+	}
+}
+
+template<typename V>
+V WrappingSubtract(const V x, const V y)
+{
+	if constexpr (std::is_integral_v<V>) {
+		return static_cast<V>(static_cast<std::uint64_t>(x) - static_cast<std::uint64_t>(y));
+	} else {
+		return x - y;
+	}
+}
+
+template<typename V>
+V WrappingMultiply(const V x, const V y)
+{
+	if constexpr (std::is_integral_v<V>) {
+		return static_cast<V>(static_cast<std::uint64_t>(x) * static_cast<std::uint64_t>(y));
+	} else {
+		return x * y;
+	}
+}
+
+template<typename V>
+V SafeDivide(const V x, const V y)
+{
+	if constexpr (std::is_floating_point_v<V>) {
+		return x / y;
+	} else if constexpr (std::is_signed_v<V>) {
+		// Both 0 and -1 (which overflows for the lowest value) are replaced by a harmless divisor.
+		const V divisor = (y == 0) | (y == -1) ? 1 : y;
+		const V quotient = x / divisor;
+		return y == 0 ? 0 : (y == -1 ? WrappingSubtract<V>(0, x) : quotient);
+	} else {
+		const V quotient = x / (y == 0 ? 1 : y);
+		return y == 0 ? 0 : quotient;
+	}
+}
+
+template<typename V>
+V SafeRemainder(const V x, const V y)
+{
+	if constexpr (std::is_floating_point_v<V>) {
+		return std::fmod(x, y);
+	} else if constexpr (std::is_signed_v<V>) {
+		const V divisor = (y == 0) | (y == -1) ? 1 : y;
+		const V remainder = x % divisor;
+		return (y == 0) | (y == -1) ? 0 : remainder;
+	} else {
+		const V remainder = x % (y == 0 ? 1 : y);
+		return y == 0 ? 0 : remainder;
+	}
+}
+
+// The result of `op` on one lane. Unary operations ignore `y`.
+template<FilterOp op, typename V>
+V ApplyFilterOp(const V x, const V y)
+{
+	if constexpr (op == FilterOp::Add) {
+		return WrappingAdd(x, y);
+	} else if constexpr (op == FilterOp::Subtract) {
+		return WrappingSubtract(x, y);
+	} else if constexpr (op == FilterOp::Multiply) {
+		return WrappingMultiply(x, y);
+	} else if constexpr (op == FilterOp::Divide) {
+		return SafeDivide(x, y);
+	} else if constexpr (op == FilterOp::Remainder) {
+		return SafeRemainder(x, y);
+	} else if constexpr (op == FilterOp::BitAnd || op == FilterOp::BitOr || op == FilterOp::BitXor) {
+		// FilterProgram rejects these for floating point types.
+		if constexpr (!std::is_integral_v<V>) {
+			return 0;
+		} else if constexpr (op == FilterOp::BitAnd) {
+			return static_cast<V>(x & y);
+		} else if constexpr (op == FilterOp::BitOr) {
+			return static_cast<V>(x | y);
+		} else {
+			return static_cast<V>(x ^ y);
+		}
+	} else if constexpr (op == FilterOp::Equal) {
+		return static_cast<V>(x == y);
+	} else if constexpr (op == FilterOp::NotEqual) {
+		return static_cast<V>(x != y);
+	} else if constexpr (op == FilterOp::Less) {
+		return static_cast<V>(x < y);
+	} else if constexpr (op == FilterOp::LessEqual) {
+		return static_cast<V>(x <= y);
+	} else if constexpr (op == FilterOp::Greater) {
+		return static_cast<V>(x > y);
+	} else if constexpr (op == FilterOp::GreaterEqual) {
+		return static_cast<V>(x >= y);
+	} else if constexpr (op == FilterOp::LogicalAnd) {
+		return static_cast<V>((x != 0) & (y != 0));
+	} else if constexpr (op == FilterOp::LogicalOr) {
+		return static_cast<V>((x != 0) | (y != 0));
+	} else if constexpr (op == FilterOp::LogicalNot) {
+		return static_cast<V>(x == 0);
+	} else {
+		static_assert(op == FilterOp::Negate);
+		return WrappingSubtract<V>(0, x);
+	}
+}
+
+// Calls `fn(std::integral_constant<FilterOp, op>())`, so `fn` can be compiled for each operation.
+template<typename Fn>
+decltype(auto) VisitFilterOp(const FilterOp op, Fn &&fn)
+{
+	switch (op) {
+	case FilterOp::Add:
+		return fn(std::integral_constant<FilterOp, FilterOp::Add>());
+	case FilterOp::Subtract:
+		return fn(std::integral_constant<FilterOp, FilterOp::Subtract>());
+	case FilterOp::Multiply:
+		return fn(std::integral_constant<FilterOp, FilterOp::Multiply>());
+	case FilterOp::Divide:
+		return fn(std::integral_constant<FilterOp, FilterOp::Divide>());
+	case FilterOp::Remainder:
+		return fn(std::integral_constant<FilterOp, FilterOp::Remainder>());
+	case FilterOp::BitAnd:
+		return fn(std::integral_constant<FilterOp, FilterOp::BitAnd>());
+	case FilterOp::BitOr:
+		return fn(std::integral_constant<FilterOp, FilterOp::BitOr>());
+	case FilterOp::BitXor:
+		return fn(std::integral_constant<FilterOp, FilterOp::BitXor>());
+	case FilterOp::Equal:
+		return fn(std::integral_constant<FilterOp, FilterOp::Equal>());
+	case FilterOp::NotEqual:
+		return fn(std::integral_constant<FilterOp, FilterOp::NotEqual>());
+	case FilterOp::Less:
+		return fn(std::integral_constant<FilterOp, FilterOp::Less>());
+	case FilterOp::LessEqual:
+		return fn(std::integral_constant<FilterOp, FilterOp::LessEqual>());
+	case FilterOp::Greater:
+		return fn(std::integral_constant<FilterOp, FilterOp::Greater>());
+	case FilterOp::GreaterEqual:
+		return fn(std::integral_constant<FilterOp, FilterOp::GreaterEqual>());
+	case FilterOp::LogicalAnd:
+		return fn(std::integral_constant<FilterOp, FilterOp::LogicalAnd>());
+	case FilterOp::LogicalOr:
+		return fn(std::integral_constant<FilterOp, FilterOp::LogicalOr>());
+	case FilterOp::LogicalNot:
+		return fn(std::integral_constant<FilterOp, FilterOp::LogicalNot>());
+	default:
+		return fn(std::integral_constant<FilterOp, FilterOp::Negate>());
+	}
+}
+
+template<typename V>
+void RunInstruction(const FilterInstruction &instruction, V (*const registers)[kernel_block_size], const size_t n)
+{
+	V *const dst = registers[instruction.dst];
+	const V *const a = registers[instruction.a];
+	const V *const b = registers[instruction.b];
+	// One tight loop per operation, which the compiler vectorizes.
+	VisitFilterOp(instruction.op, [&]<FilterOp op>(std::integral_constant<FilterOp, op>) {
+		for (size_t i = 0; i < n; ++i) {
+			dst[i] = ApplyFilterOp<op>(a[i], b[i]);
+		}
+	});
+}
+
+}  // namespace internal
+
+template<typename T>
+FilterProgram<T>::FilterProgram(const FilterExpression &expression)
+	: instructions(expression.Instructions()), result_register(expression.ResultRegister())
+{
+	if (std::is_floating_point_v<Value> && expression.UsesBitwise()) {
+		throw MemoryScannerException("Bitwise operators in a filter need an integer type");
+	}
+	constants.reserve(expression.Constants().size());
+	for (const ScanValue &constant : expression.Constants()) {
+		constants.push_back(constant.Get<Value>());
+	}
+}
+
+template<typename T>
+std::uint64_t FilterProgram<T>::EvaluateBlock(const T *const prev, const T *const cur, const size_t n) const
+{
+	alignas(64) Value registers[max_filter_registers][kernel_block_size];
+	Scalar<T> loaded[kernel_block_size];
+	LoadScalars(prev, n, loaded);
+	for (size_t i = 0; i < n; ++i) {
+		registers[0][i] = static_cast<Value>(loaded[i]);
+	}
+	LoadScalars(cur, n, loaded);
+	for (size_t i = 0; i < n; ++i) {
+		registers[1][i] = static_cast<Value>(loaded[i]);
+	}
+	for (size_t c = 0; c < constants.size(); ++c) {
+		for (size_t i = 0; i < n; ++i) {
+			registers[2 + c][i] = constants[c];
+		}
+	}
+	for (const FilterInstruction &instruction : instructions) {
+		internal::RunInstruction(instruction, registers, n);
+	}
+	const Value *const result = registers[result_register];
+	std::uint64_t mask = 0;
+	for (size_t i = 0; i < n; ++i) {
+		mask |= static_cast<std::uint64_t>(result[i] != 0) << i;
+	}
+	return mask;
+}
+
+template<typename T>
+bool FilterProgram<T>::operator()(const T &prev, const T &cur) const
+{
+	Value registers[max_filter_registers];
+	registers[0] = static_cast<Value>(LoadScalar(prev));
+	registers[1] = static_cast<Value>(LoadScalar(cur));
+	for (size_t c = 0; c < constants.size(); ++c) {
+		registers[2 + c] = constants[c];
+	}
+	for (const FilterInstruction &instruction : instructions) {
+		const Value x = registers[instruction.a];
+		const Value y = registers[instruction.b];
+		registers[instruction.dst] = internal::VisitFilterOp(instruction.op,
+			[x, y]<FilterOp op>(std::integral_constant<FilterOp, op>) { return internal::ApplyFilterOp<op>(x, y); });
+	}
+	return registers[result_register] != 0;
+}
+
+}  // namespace memory_scanner
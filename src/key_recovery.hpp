@@ -0,0 +1,116 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include "filter_combinators.hpp"
+#include "memory_scanner.hpp"
+#include "scan_types.hpp"
+#include "snapshot_index.hpp"
+
+namespace memory_scanner
+{
+
+// The key that decodes the value stored at an address into the value being searched for.
+template<typename T>
+class RecoveredKey
+{
+public:
+	IntPtr address;
+	Scalar<T> key;
+};
+
+// For every address in `addresses` that `snapshot` holds, the key with `stored ^ key == value`. Addresses found with
+// `filters::XorChangedBy` or `filters::XorKeyIn` are the usual input. The key follows from a single XOR, so nothing is
+// brute forced.
+template<typename T>
+std::vector<RecoveredKey<T>> RecoverXorKeys(const SnapshotIndex &snapshot, const std::vector<IntPtr> &addresses,
+	Scalar<T> value);
+
+// Same as above for values stored as `value + key`, with `filters::AddChangedBy` or `filters::AddKeyIn`.
+template<typename T>
+std::vector<RecoveredKey<T>> RecoverAddKeys(const SnapshotIndex &snapshot, const std::vector<IntPtr> &addresses,
+	Scalar<T> value);
+
+// Returns the key recovered at the most addresses, which is the key of the process if it uses one key for all values.
+// Returns nothing if `keys` is empty.
+template<typename T>
+std::optional<Scalar<T>> MostCommonKey(const std::vector<RecoveredKey<T>> &keys);
+
+//
+// Implementations of templated functions below...
+//
+
+namespace internal
+{
+
+template<typename T, typename Decode>
+std::vector<RecoveredKey<T>> RecoverKeys(const SnapshotIndex &snapshot, const std::vector<IntPtr> &addresses,
+	const Decode &decode)
+{
+	std::vector<RecoveredKey<T>> keys;
+	keys.reserve(addresses.size());
+	for (const IntPtr address : addresses) {
+		if (const std::optional<T> stored = snapshot.Read<T>(address)) {
+			keys.push_back(RecoveredKey<T>{ address, decode(LoadScalar(*stored)) });
+		}
+	}
+	return keys;
+}
+
+}  // namespace internal
+
+template<typename T>
+std::vector<RecoveredKey<T>> RecoverXorKeys(const SnapshotIndex &snapshot, const std::vector<IntPtr> &addresses,
+	const Scalar<T> value)
+{
+	using S = Scalar<T>;
+	return internal::RecoverKeys<T>(snapshot, addresses, [value](const S stored) {
+		return static_cast<S>(filters::internal::Unsigned(stored) ^ filters::internal::Unsigned(value));
+	});
+}
+
+template<typename T>
+std::vector<RecoveredKey<T>> RecoverAddKeys(const SnapshotIndex &snapshot, const std::vector<IntPtr> &addresses,
+	const Scalar<T> value)
+{
+	using S = Scalar<T>;
+	return internal::RecoverKeys<T>(snapshot, addresses, [value](const S stored) {
+		using U = std::make_unsigned_t<S>;
+		return static_cast<S>(static_cast<U>(filters::internal::Unsigned(stored) - filters::internal::Unsigned(value)));
+	});
+}
+
+template<typename T>
+std::optional<Scalar<T>> MostCommonKey(const std::vector<RecoveredKey<T>> &keys)
+{
+	std::vector<Scalar<T>> sorted;
+	sorted.reserve(keys.size());
+	for (const RecoveredKey<T> &key : keys) {
+		sorted.push_back(key.key);
+	}
+	std::sort(sorted.begin(), sorted.end());
+	std::optional<Scalar<T>> best;
+	size_t best_count = 0;
+	for (size_t i = 0; i < sorted.size();) {
+		size_t j = i + 1;
+		while (j < sorted.size() && sorted[j] == sorted[i]) {
+			++j;
+		}
+		if (j - i > best_count) {
+			best = sorted[i];
+			best_count = j - i;
+		}
+		i = j;
+	}
+	return best;
+}
+
+}  // namespace memory_scanner
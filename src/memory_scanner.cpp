@@ -4,36 +4,117 @@
 #define NOMINMAX
 #include <Windows.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <initializer_list>
+#include <memory>
 #include <source_location>
 #include <string>
 #include <utility>
 
 #include "memory_scanner_exception.hpp"
+#include "numa.hpp"
+#include "read_limiter.hpp"
 
 namespace memory_scanner
 {
 
-SIZE_T ReadRegionData(HANDLE process, MemoryRegion &memory_region)
+void RegionDataDeleter::operator()(char *const data) const
+{
+	if (virtual_alloc) {
+		VirtualFree(data, 0, MEM_RELEASE);
+	} else {
+		delete[] data;
+	}
+}
+
+RegionData AllocateRegionData(const size_t length, const DWORD numa_node)
+{
+	static const DWORD allocation_granularity = [] {
+		SYSTEM_INFO system_info;
+		GetSystemInfo(&system_info);
+		return system_info.dwAllocationGranularity;
+	}();
+	if (numa_node == NUMA_NO_PREFERRED_NODE || length < allocation_granularity) {
+		return RegionData(new char[length](), RegionDataDeleter{ .numa_node = numa_node });
+	}
+	void *const data = VirtualAllocExNuma(GetCurrentProcess(), nullptr, length, MEM_RESERVE | MEM_COMMIT,
+		PAGE_READWRITE, numa_node);
+	if (data == nullptr) {
+		const DWORD ec = GetLastError();
+		throw MemoryScannerException("Cannot allocate region buffer on NUMA node", ec);
+	}
+	return RegionData(static_cast<char *>(data), RegionDataDeleter{ .numa_node = numa_node, .virtual_alloc = true });
+}
+
+namespace
+{
+
+SIZE_T ReadMemoryOnce(HANDLE process, const IntPtr address, char *const dest, const SIZE_T length)
 {
-	memory_region.data = std::make_unique<char[]>(memory_region.length);
 	SIZE_T bytes_read = 0;
-	void *address = reinterpret_cast<void *>(memory_region.base_address);
-	if (!ReadProcessMemory(process, address, memory_region.data.get(), memory_region.length, &bytes_read)) {
+	void *const ptr = reinterpret_cast<void *>(address);
+	if (!ReadProcessMemory(process, ptr, dest, length, &bytes_read)) {
 		const DWORD ec = GetLastError();
 		if (ec != ERROR_PARTIAL_COPY) {
-			throw MemoryScannerException("Cannot read process memory", ec, address);
+			throw MemoryScannerException("Cannot read process memory", ec, ptr);
 		}
 	}
 	return bytes_read;
 }
 
-std::vector<MemoryRegion> InitialScan(HANDLE process)
+// Reads in pieces of at most `MaxReadSize` bytes, each admitted by the limiter. Stops at the first partial piece.
+SIZE_T ReadMemoryLimited(HANDLE process, const IntPtr address, char *const dest, const SIZE_T length,
+	ReadLimiter &limiter)
+{
+	SIZE_T total = 0;
+	while (total < length) {
+		const SIZE_T piece = std::min<SIZE_T>(length - total, limiter.MaxReadSize());
+		limiter.Acquire(piece);
+		SIZE_T bytes_read = 0;
+		try {
+			bytes_read = ReadMemoryOnce(process, address + total, dest + total, piece);
+		} catch (...) {
+			limiter.Release(0);
+			throw;
+		}
+		limiter.Release(bytes_read);
+		total += bytes_read;
+		if (bytes_read < piece) {
+			break;
+		}
+	}
+	return total;
+}
+
+}  // namespace
+
+SIZE_T ReadMemory(HANDLE process, const IntPtr address, char *const dest, const SIZE_T length)
+{
+	const std::shared_ptr<ReadLimiter> limiter = GetReadLimiter(process);
+	if (limiter != nullptr) {
+		return ReadMemoryLimited(process, address, dest, length, *limiter);
+	}
+	return ReadMemoryOnce(process, address, dest, length);
+}
+
+SIZE_T ReadRegionData(HANDLE process, MemoryRegion &memory_region)
+{
+	const IntPtr total_length = memory_region.length + memory_region.overlap;
+	memory_region.data = AllocateRegionData(total_length, CurrentThreadNumaNode());
+	const SIZE_T bytes_read =
+		ReadMemory(process, memory_region.base_address, memory_region.data.get(), total_length);
+	if (bytes_read < total_length) {
+		memory_region.overlap = bytes_read > memory_region.length ? bytes_read - memory_region.length : 0;
+	}
+	return std::min<SIZE_T>(bytes_read, memory_region.length);
+}
+
+std::vector<MemoryRegion> QueryRegions(HANDLE process, const IntPtr begin, const IntPtr end)
 {
 	std::vector<MemoryRegion> regions;
-	for (char *address = nullptr;;) {
+	for (char *address = reinterpret_cast<char *>(begin); reinterpret_cast<IntPtr>(address) < end;) {
 		MEMORY_BASIC_INFORMATION mem_info;
 		const SIZE_T size = VirtualQueryEx(process, address, &mem_info, sizeof(mem_info));
 		if (size == 0) {
@@ -42,27 +123,162 @@ std::vector<MemoryRegion> InitialScan(HANDLE process)
 				break;
 			}
 			throw MemoryScannerException("Cannot VirtualQueryEx process", ec);
-			continue;
 		}
-		address += mem_info.RegionSize;
+		address = reinterpret_cast<char *>(mem_info.BaseAddress) + mem_info.RegionSize;
 		if (mem_info.State != MEM_COMMIT) {
 			continue;
 		}
 		if (mem_info.Protect != PAGE_READWRITE && mem_info.Protect != PAGE_EXECUTE_READWRITE) {
 			continue;
 		}
-		const char *const start = reinterpret_cast<const char *>(mem_info.BaseAddress);
-		const char *const end = start + mem_info.RegionSize;
+		// Clip to the requested range, the first and last regions may stick out of it.
+		const IntPtr region_begin = std::max(reinterpret_cast<IntPtr>(mem_info.BaseAddress), begin);
+		const IntPtr region_end = std::min(reinterpret_cast<IntPtr>(address), end);
 		MemoryRegion region;
-		region.base_address = reinterpret_cast<IntPtr>(mem_info.BaseAddress);
-		region.length = static_cast<IntPtr>(mem_info.RegionSize);
+		region.base_address = region_begin;
+		region.length = region_end - region_begin;
+		region.type = mem_info.Type;
+		region.allocation_base = reinterpret_cast<IntPtr>(mem_info.AllocationBase);
+		regions.push_back(std::move(region));
+	}
+	return regions;
+}
+
+namespace
+{
+
+// Whether two adjacent regions may share a span. Image and mapped memory only merge within the same module or view,
+// private memory merges across allocations since fragmented heaps are what merging is for.
+bool CanCoalesce(const MemoryRegion &a, const MemoryRegion &b)
+{
+	if (a.type != b.type) {
+		return false;
+	}
+	return a.type == MEM_PRIVATE || a.allocation_base == b.allocation_base;
+}
+
+}  // namespace
+
+void CoalesceRegions(std::vector<MemoryRegion> &regions, const IntPtr max_span_length)
+{
+	if (regions.empty() || max_span_length == 0) {
+		return;
+	}
+	size_t new_size = 0;
+	for (size_t r = 1; r < regions.size(); ++r) {
+		MemoryRegion &span = regions[new_size];
+		if (span.base_address + span.length == regions[r].base_address &&
+			span.length + regions[r].length <= max_span_length && CanCoalesce(span, regions[r])) {
+			span.length += regions[r].length;
+			continue;
+		}
+		++new_size;
+		if (new_size != r) {
+			std::swap(regions[new_size], regions[r]);
+		}
+	}
+	regions.resize(new_size + 1);
+}
+
+void SetBoundaryOverlaps(std::vector<MemoryRegion> &regions, const IntPtr overlap)
+{
+	for (size_t r = 0; r < regions.size(); ++r) {
+		const bool followed = r + 1 < regions.size() &&
+			regions[r].base_address + regions[r].length == regions[r + 1].base_address;
+		regions[r].overlap = followed ? overlap : 0;
+	}
+}
+
+std::vector<MemoryRegion> ReadSpan(HANDLE process, MemoryRegion span)
+{
+	std::vector<MemoryRegion> regions;
+	const IntPtr span_overlap = span.overlap;
+	if (ReadRegionData(process, span) == span.length) {
+		regions.push_back(std::move(span));
+		return regions;
+	}
+	regions = QueryRegions(process, span.base_address, span.base_address + span.length);
+	SetBoundaryOverlaps(regions, span_overlap);
+	if (!regions.empty() && regions.back().base_address + regions.back().length == span.base_address + span.length) {
+		regions.back().overlap = span_overlap;
+	}
+	for (MemoryRegion &region : regions) {
 		const SIZE_T bytes_read = ReadRegionData(process, region);
-		if (bytes_read != mem_info.RegionSize) {
+		if (bytes_read != region.length) {
 			throw MemoryScannerException("Bytes read differs from region size");
 		}
-		regions.push_back(std::move(region));
 	}
 	return regions;
 }
 
+std::vector<MemoryRegion> InitialScan(HANDLE process, const InitialScanOptions &options)
+{
+	std::vector<MemoryRegion> spans = QueryRegions(process, 0, ~IntPtr(0));
+	CoalesceRegions(spans, options.max_span_length);
+	SetBoundaryOverlaps(spans, options.boundary_overlap);
+	std::vector<MemoryRegion> regions;
+	regions.reserve(spans.size());
+	for (MemoryRegion &span : spans) {
+		for (MemoryRegion &region : ReadSpan(process, std::move(span))) {
+			regions.push_back(std::move(region));
+		}
+	}
+	return regions;
+}
+
+IntPtr PageSize()
+{
+	static const IntPtr page_size = [] {
+		SYSTEM_INFO system_info;
+		GetSystemInfo(&system_info);
+		return static_cast<IntPtr>(system_info.dwPageSize);
+	}();
+	return page_size;
+}
+
+size_t GroupCandidatePages(const IntPtr *const addresses, const size_t count, const size_t value_size, IntPtr &begin,
+	IntPtr &end)
+{
+	const IntPtr page_size = PageSize();
+	const IntPtr page_mask = ~(page_size - 1);
+	// Grow the span page by page while the next address starts on a page it already covers or right after it.
+	begin = addresses[0] & page_mask;
+	end = begin;
+	size_t n = 0;
+	while (n < count && (addresses[n] & page_mask) <= end) {
+		end = std::max(end, ((addresses[n] + value_size - 1) & page_mask) + page_size);
+		++n;
+	}
+	return n;
+}
+
+std::vector<MemoryRegion> ReadCandidateRegions(HANDLE process, std::vector<IntPtr> &addresses, const size_t value_size)
+{
+	std::vector<MemoryRegion> regions;
+	size_t new_size_a = 0;
+	size_t a = 0;
+	while (a < addresses.size()) {
+		MemoryRegion region;
+		IntPtr end = 0;
+		const size_t end_a =
+			a + GroupCandidatePages(&addresses[a], addresses.size() - a, value_size, region.base_address, end);
+		region.length = end - region.base_address;
+		const SIZE_T bytes_read = ReadRegionData(process, region);
+		// Keep only the addresses that were read in full.
+		for (size_t i = a; i < end_a; ++i) {
+			if (addresses[i] + value_size <= region.base_address + bytes_read) {
+				addresses[new_size_a] = addresses[i];
+				++new_size_a;
+			}
+		}
+		if (bytes_read != 0) {
+			region.length = bytes_read;
+			regions.push_back(std::move(region));
+		}
+		a = end_a;
+	}
+	addresses.resize(new_size_a);
+	return regions;
+}
+
 }  // namespace memory_scanner
@@ -3,9 +3,13 @@
 #define STRICT
 #define NOMINMAX
 #include <Windows.h>
+#include <xmmintrin.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <span>
 #include <string>
@@ -14,19 +18,47 @@
 #include <vector>
 
 #include "memory_scanner_exception.hpp"
+#include "scan_kernels.hpp"
 
 namespace memory_scanner
 {
 
 using IntPtr = ULONG_PTR;
 
+// Frees the buffer of a `MemoryRegion`. Buffers bound to a NUMA node come from VirtualAllocExNuma rather than new[].
+class RegionDataDeleter
+{
+public:
+	// The node the buffer was allocated for, or NUMA_NO_PREFERRED_NODE.
+	DWORD numa_node = NUMA_NO_PREFERRED_NODE;
+	// Whether the buffer came from VirtualAllocExNuma.
+	bool virtual_alloc = false;
+
+	void operator()(char *data) const;
+};
+
+using RegionData = std::unique_ptr<char[], RegionDataDeleter>;
+
+// Allocates a zeroed buffer for a `MemoryRegion`. Buffers of at least the allocation granularity are bound to
+// `numa_node` unless it is NUMA_NO_PREFERRED_NODE. Smaller ones come from new[] since binding works on whole
+// allocations and they would waste most of one; they are still zeroed, and so first touched, by the calling thread.
+RegionData AllocateRegionData(size_t length, DWORD numa_node);
+
 // Represents a continuous region in process memory that can span multiple pages.
 class MemoryRegion
 {
 public:
 	IntPtr base_address = 0;
 	IntPtr length = 0;
-	std::unique_ptr<char[]> data = nullptr;
+	// The number of bytes past `length` that were also read into `data` from the region directly following this one,
+	// so that values starting near the end of this region can be read whole. Addresses in the overlap still belong to
+	// the next region.
+	IntPtr overlap = 0;
+	// The memory type (MEM_IMAGE, MEM_MAPPED or MEM_PRIVATE) and allocation base reported by VirtualQueryEx for the
+	// start of the region by `QueryRegions`, or 0 if the region was not queried.
+	DWORD type = 0;
+	IntPtr allocation_base = 0;
+	RegionData data = nullptr;
 
 	bool ContainsAddress(const IntPtr address) const
 	{
@@ -46,26 +78,83 @@ public:
 	void ReRead(HANDLE process);
 };
 
+// Knobs for the restricted scan. The defaults are good for most targets, see memory_scan_bench to tune them.
+class ScanTuning
+{
+public:
+	// How many candidates ahead of the one being filtered to prefetch from the old and new region buffers. 0 disables
+	// prefetching.
+	size_t prefetch_distance = 16;
+	// A region with fewer than one candidate per this many bytes is re-read page by page around its candidates instead
+	// of in full. Pages without candidates then keep their old contents in the region buffer. 0 disables this.
+	IntPtr sparse_bytes_per_candidate = IntPtr(64) << 10;
+};
+
 // Considers the MemoryObject a candidate if the function returns true. The first parameter is the value from the
-// previous scan and the second parameter is the value from the current scan.
+// previous scan and the second parameter is the value from the current scan. The scans accept any callable with this
+// signature; passing a lambda or function object directly instead of wrapping it in a FilterFn lets the compiler
+// inline and vectorize it.
 template<typename T>
 using FilterFn = std::function<bool(const T &, const T &)>;
 
+// Reads `length` bytes at `address` of the process into `dest`. A partial copy is not an error, the number of bytes
+// read is returned instead. Waits for the `ReadLimiter` of the process first if it has one.
+SIZE_T ReadMemory(HANDLE process, IntPtr address, char *dest, SIZE_T length);
+
 // Reads a single region of memory. Uses `memory_region.base_address` to know where to read and `memory_region.length`
 // to know how much to read. Reallocates and rewrites the values of `memory_region.data`, so it can be passed in as
-// nullptr.
+// nullptr. The `memory_region.overlap` bytes after the region are read as well, and the overlap is reduced to what
+// could actually be read. Returns the number of bytes of the region itself that were read. The new buffer is bound to
+// the NUMA node of the calling thread if it was pinned with `PinCurrentThreadToNumaNode`.
 SIZE_T ReadRegionData(HANDLE process, MemoryRegion &memory_region);
 
+// Discovers the memory regions with R/W permissions that overlap [begin, end) without reading them, so `.data` is left
+// as nullptr. Regions sticking out of the range are clipped to it. The regions are sorted from lowest base address to
+// highest base address.
+std::vector<MemoryRegion> QueryRegions(HANDLE process, IntPtr begin, IntPtr end);
+
+// Merges runs of regions where each ends exactly where the next begins into single regions of at most
+// `max_span_length` bytes, so they can be read and scanned with one call and one buffer each. Regions already longer
+// than that are left alone. Works on regions without data, as returned by `QueryRegions`.
+void CoalesceRegions(std::vector<MemoryRegion> &regions, IntPtr max_span_length);
+
+// Sets the overlap of every region that is directly followed by another region to `overlap` bytes, and to 0 otherwise.
+// Works on regions without data, the overlap is read along with the region by `ReadRegionData`.
+void SetBoundaryOverlaps(std::vector<MemoryRegion> &regions, IntPtr overlap);
+
+// Reads a region that may have been merged by `CoalesceRegions`. If it cannot be read in one go, for example because
+// part of it was freed or re-protected since it was queried, its range is queried again and each piece is read on its
+// own. Returns the regions read, sorted from lowest base address to highest.
+std::vector<MemoryRegion> ReadSpan(HANDLE process, MemoryRegion span);
+
+// Options for `InitialScan`.
+class InitialScanOptions
+{
+public:
+	// Adjacent regions are merged into spans of up to this many bytes, see `CoalesceRegions`. 0 keeps every region as
+	// reported by VirtualQueryEx.
+	IntPtr max_span_length = IntPtr(16) << 20;
+	// Regions still directly followed by another one after merging also read this many bytes of the next, see
+	// `MemoryRegion::overlap`. Values up to one byte longer than this are found even when they straddle two regions.
+	IntPtr boundary_overlap = 31;
+};
+
 // Discovers and reads all memory regions from process with R/W permissions. The regions are sorted from lowest base
 // address to highest base address addresses.
-std::vector<MemoryRegion> InitialScan(HANDLE process);
+std::vector<MemoryRegion> InitialScan(HANDLE process, const InitialScanOptions &options = InitialScanOptions());
+
+// Reads only the pages of the process that hold the values at `addresses`, each `value_size` bytes long, instead of
+// every region like `InitialScan`. Consecutive pages are read as one region. Use this to resume scanning a set of
+// candidates found earlier, for example from `AddressTranslator::ResolveCandidateSet`, with the restricted `NextScan`.
+// `addresses` must be sorted from low to high, addresses that cannot be read are removed from it.
+std::vector<MemoryRegion> ReadCandidateRegions(HANDLE process, std::vector<IntPtr> &addresses, size_t value_size);
 
 // Reads the memory regions from the process as dictated by `regions`. Applies the filter for all values, which compares
 // the current value to the old value. If nothing matches in that region, it will be removed from `regions`. If it does
 // match, that entry in `regions` will be updated with the new process memory. Returns a vector of addresses which
 // matched sorted from lowest address to highest.
-template<typename T>
-std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions, FilterFn<T> keep_if);
+template<typename T, typename Filter = FilterFn<T>>
+std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions, const Filter &keep_if);
 
 // Same as above, but filter will only considers entries contained in `valid_addresses`.
 // * This function will remove entries from  `valid_addresses` if they no longer match the filter.
@@ -75,39 +164,210 @@ std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions,
 // * `valid_addresses` must be sorted from low to high.
 // * The above two constaints should not be a problem if no re-ordering of the vectors happens in your code between
 // calls of `InitialScan` and `NextScan`
-template<typename T>
+template<typename T, typename Filter = FilterFn<T>>
 void NextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses,
-	FilterFn<T> keep_if);
+	const Filter &keep_if, const ScanTuning &tuning = ScanTuning());
+
+// Re-reads a single region and appends every address that passes the filter to `valid_addresses`. `region` is replaced
+// with the newly read memory only if at least one address passed. Returns whether any address passed.
+template<typename T, typename Filter>
+bool ScanRegion(HANDLE process, MemoryRegion &region, const Filter &keep_if, std::vector<IntPtr> &valid_addresses);
+
+// Same as ScanRegion, but calls `on_match(address, prev, cur)` for every address that passes instead of collecting the
+// addresses, while both the old and the new values are still at hand.
+template<typename T, typename Filter, typename OnMatch>
+bool ScanRegionMatches(HANDLE process, MemoryRegion &region, const Filter &keep_if, OnMatch &&on_match);
+
+// Re-reads a single region and applies the filter only to the `count` addresses starting at `candidates`, which must
+// all be contained in `region` and sorted from low to high. The addresses that pass are moved to the front of
+// `candidates` in a stable manner. `region` is updated with the newly read memory only if at least one address passed.
+// Returns the number of addresses that passed.
+template<typename T, typename Filter>
+size_t ScanRegionCandidates(HANDLE process, MemoryRegion &region, IntPtr *candidates, size_t count,
+	const Filter &keep_if, const ScanTuning &tuning = ScanTuning());
+
+// Returns the page size of the machine.
+IntPtr PageSize();
+
+// Finds the span of whole pages holding the first run of `addresses` (sorted from low to high) whose pages touch or
+// overlap, where each address refers to `value_size` bytes. Returns how many addresses the span holds.
+size_t GroupCandidatePages(const IntPtr *addresses, size_t count, size_t value_size, IntPtr &begin, IntPtr &end);
 
 //
 // Implementations of templated functions below...
 //
 
-template<typename T>
-std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions, FilterFn<T> keep_if)
+template<typename T, typename Filter>
+bool ScanRegion(HANDLE process, MemoryRegion &region, const Filter &keep_if, std::vector<IntPtr> &valid_addresses)
+{
+	return ScanRegionMatches<T>(process, region, keep_if,
+		[&valid_addresses](const IntPtr address, const T &, const T &) { valid_addresses.push_back(address); });
+}
+
+template<typename T, typename Filter, typename OnMatch>
+bool ScanRegionMatches(HANDLE process, MemoryRegion &region, const Filter &keep_if, OnMatch &&on_match)
+{
+	MemoryRegion new_region;
+	new_region.base_address = region.base_address;
+	new_region.length = region.length;
+	new_region.overlap = region.overlap;
+	new_region.type = region.type;
+	new_region.allocation_base = region.allocation_base;
+	ReadRegionData(process, new_region);
+	const T *const old_ptr = reinterpret_cast<const T *>(region.data.get());
+	const T *const new_ptr = reinterpret_cast<const T *>(new_region.data.get());
+	// Every value starting in the region, including those continuing into the overlap of both reads.
+	const IntPtr overlap = std::min(region.overlap, new_region.overlap);
+	const size_t count = std::min((region.length + sizeof(T) - 1) / sizeof(T), (region.length + overlap) / sizeof(T));
+	bool found_at_least_one_valid_address = false;
+	ForEachMatch(old_ptr, new_ptr, count, keep_if, [&](const size_t i) {
+		on_match(new_region.base_address + (i * sizeof(T)), old_ptr[i], new_ptr[i]);
+		found_at_least_one_valid_address = true;
+	});
+	if (found_at_least_one_valid_address) {
+		// Replace memory region with the new one.
+		region = std::move(new_region);
+	}
+	return found_at_least_one_valid_address;
+}
+
+namespace internal
+{
+
+// Returns the first iterator in [first, last) for which `before` is false, where `before` must be true for a prefix of
+// the range and false afterwards. Probes first at exponentially growing distances and then binary searches the last
+// gap, so the cost is logarithmic in the distance to the answer rather than in the size of the range.
+template<typename It, typename Pred>
+It Gallop(It first, const It last, const Pred &before)
+{
+	typename std::iterator_traits<It>::difference_type step = 1;
+	while (last - first > step && before(first[step - 1])) {
+		first += step;
+		step *= 2;
+	}
+	return std::partition_point(first, first + std::min(step, last - first), before);
+}
+
+// For each region, the index of the first of `valid_addresses` it holds and how many it holds. Addresses outside of
+// every region belong to no region. Both vectors must be sorted from low to high.
+inline void GroupCandidates(const std::vector<MemoryRegion> &regions, const std::vector<IntPtr> &valid_addresses,
+	std::vector<size_t> &begin, std::vector<size_t> &count)
+{
+	begin.assign(regions.size(), 0);
+	count.assign(regions.size(), 0);
+	auto a = valid_addresses.begin();
+	for (size_t r = 0; r < regions.size(); ++r) {
+		const IntPtr region_begin = regions[r].base_address;
+		const IntPtr region_end = region_begin + regions[r].length;
+		a = Gallop(a, valid_addresses.end(), [region_begin](const IntPtr address) { return address < region_begin; });
+		const auto end_a =
+			Gallop(a, valid_addresses.end(), [region_end](const IntPtr address) { return address < region_end; });
+		begin[r] = a - valid_addresses.begin();
+		count[r] = end_a - a;
+		a = end_a;
+	}
+}
+
+// The sparse path of `ScanRegionCandidates`. Only the pages around the candidates are read, into a scratch buffer, and
+// copied over the old contents of `region` after filtering.
+template<typename T, typename Filter>
+size_t ScanSparseCandidates(HANDLE process, MemoryRegion &region, IntPtr *const candidates, const size_t count,
+	const Filter &keep_if)
+{
+	std::vector<char> scratch;
+	size_t kept = 0;
+	size_t i = 0;
+	while (i < count) {
+		IntPtr begin = 0;
+		IntPtr end = 0;
+		const size_t end_i = i + GroupCandidatePages(candidates + i, count - i, sizeof(T), begin, end);
+		// Regions clipped by `QueryRegions` may start or end in the middle of a page, and the last values may continue
+		// into the overlap.
+		begin = std::max(begin, region.base_address);
+		end = std::min(end, region.base_address + region.length + region.overlap);
+		scratch.assign(end - begin, 0);
+		// A short read, for example of pages freed since the last scan, leaves the candidates past it unread. They are
+		// dropped and the old data there is left alone.
+		const SIZE_T bytes_read = ReadMemory(process, begin, scratch.data(), end - begin);
+		const IntPtr read_end = begin + bytes_read;
+		char *const old_bytes = region.data.get() + (begin - region.base_address);
+		for (size_t k = i; k < end_i; ++k) {
+			// Index the same elements as the whole-region path, which counts from the region base.
+			const IntPtr element = region.base_address +
+				((candidates[k] - region.base_address) / sizeof(T)) * sizeof(T);
+			if (element + sizeof(T) > read_end) {
+				continue;
+			}
+			T old_value;
+			T new_value;
+			std::memcpy(&old_value, old_bytes + (element - begin), sizeof(T));
+			std::memcpy(&new_value, scratch.data() + (element - begin), sizeof(T));
+			if (keep_if(old_value, new_value)) {
+				candidates[kept] = candidates[k];
+				++kept;
+			}
+		}
+		std::memcpy(old_bytes, scratch.data(), bytes_read);
+		i = end_i;
+	}
+	return kept;
+}
+
+}  // namespace internal
+
+template<typename T, typename Filter>
+size_t ScanRegionCandidates(HANDLE process, MemoryRegion &region, IntPtr *const candidates, const size_t count,
+	const Filter &keep_if, const ScanTuning &tuning)
+{
+	if (tuning.sparse_bytes_per_candidate != 0 && count != 0 &&
+		region.length / count >= tuning.sparse_bytes_per_candidate) {
+		return internal::ScanSparseCandidates<T>(process, region, candidates, count, keep_if);
+	}
+	MemoryRegion new_region;
+	new_region.base_address = region.base_address;
+	new_region.length = region.length;
+	new_region.overlap = region.overlap;
+	new_region.type = region.type;
+	new_region.allocation_base = region.allocation_base;
+	ReadRegionData(process, new_region);
+	const T *const old_ptr = reinterpret_cast<const T *>(region.data.get());
+	const T *const new_ptr = reinterpret_cast<const T *>(new_region.data.get());
+	const size_t prefetch_distance = tuning.prefetch_distance;
+	// A value continuing into the overlap is dropped if either read could not get all of it.
+	const IntPtr readable_end = region.base_address + region.length + std::min(region.overlap, new_region.overlap);
+	size_t kept = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (prefetch_distance != 0 && i + prefetch_distance < count) {
+			const size_t ahead = (candidates[i + prefetch_distance] - region.base_address) / sizeof(T);
+			_mm_prefetch(reinterpret_cast<const char *>(old_ptr + ahead), _MM_HINT_T0);
+			_mm_prefetch(reinterpret_cast<const char *>(new_ptr + ahead), _MM_HINT_T0);
+		}
+		// Puts the absolute address into something that can be indexed into the arrays of type T.
+		const size_t translated_index = (candidates[i] - region.base_address) / sizeof(T);
+		if (region.base_address + (translated_index + 1) * sizeof(T) > readable_end) {
+			continue;
+		}
+		if (keep_if(old_ptr[translated_index], new_ptr[translated_index])) {
+			candidates[kept] = candidates[i];
+			++kept;
+		}
+	}
+	if (kept != 0) {
+		// Replace memory region with the new one.
+		region = std::move(new_region);
+	}
+	return kept;
+}
+
+template<typename T, typename Filter>
+std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions, const Filter &keep_if)
 {
 	std::vector<IntPtr> valid_addresses;
 	// Swap regions to want to keep to the beginning so all the unwanted regions end up at the back of the vector. Then
 	// resize the vector after iterating to truncate the deleted regions. This is stable so the order is preserved.
 	size_t new_size = 0;
 	for (size_t r = 0; r < regions.size(); ++r) {
-		MemoryRegion new_region;
-		new_region.base_address = regions[r].base_address;
-		new_region.length = regions[r].length;
-		ReadRegionData(process, new_region);
-		const T *const old_ptr = reinterpret_cast<const T *>(regions[r].data.get());
-		const T *const new_ptr = reinterpret_cast<const T *>(new_region.data.get());
-		const size_t count = regions[r].length / sizeof(T);
-		bool found_at_least_one_valid_address = false;
-		for (size_t i = 0; i < count; ++i) {
-			if (keep_if(old_ptr[i], new_ptr[i])) {
-				found_at_least_one_valid_address = true;
-				valid_addresses.push_back(new_region.base_address + (i * sizeof(T)));
-			}
-		}
-		if (found_at_least_one_valid_address) {
-			// Replace memory region with the new one.
-			regions[r] = std::move(new_region);
+		if (ScanRegion<T>(process, regions[r], keep_if, valid_addresses)) {
 			// Keep this element by swapping to front. Only swap if it isn't in the correct position.
 			if (new_size != r) {
 				std::swap(regions[new_size], regions[r]);
@@ -120,9 +380,9 @@ std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions,
 	return valid_addresses;
 }
 
-template<typename T>
+template<typename T, typename Filter>
 void NextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses,
-	FilterFn<T> keep_if)
+	const Filter &keep_if, const ScanTuning &tuning)
 {
 	// Swap elements to want to keep to the beginning so all the unwanted elements end up at the back of the vector.
 	// Then resize the vector after iterating to truncate the deleted elements. This is stable so the order is
@@ -132,38 +392,35 @@ void NextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<In
 	size_t r = 0;
 	size_t a = 0;
 	while (r < regions.size() && a < valid_addresses.size()) {
-		if (!regions[r].ContainsAddress(valid_addresses[a])) {
-			// This region will be skipped (deleted) since it contains no addresses.
-			++r;
+		// Regions ending before the next address contain no addresses and will be skipped (deleted). Late scans often
+		// skip thousands of regions at once, so search rather than walk.
+		const IntPtr address = valid_addresses[a];
+		r = internal::Gallop(regions.begin() + r, regions.end(), [address](const MemoryRegion &region) {
+			return region.base_address + region.length <= address;
+		}) - regions.begin();
+		if (r == regions.size()) {
+			break;
+		}
+		if (!regions[r].ContainsAddress(address)) {
+			// The address is not in any region so it cannot be read. Drop it.
+			++a;
 			continue;
 		}
-		MemoryRegion new_region;
-		new_region.base_address = regions[r].base_address;
-		new_region.length = regions[r].length;
-		ReadRegionData(process, new_region);
+		// Gather every address contained in this region.
+		const IntPtr region_end = regions[r].base_address + regions[r].length;
+		const size_t end_a = internal::Gallop(valid_addresses.begin() + a + 1, valid_addresses.end(),
+			[region_end](const IntPtr candidate) { return candidate < region_end; }) - valid_addresses.begin();
 		// Apply the filter for all addresses in this region. Remove the region if nothing valid is found.
-		bool found_at_least_one_valid_address = false;
-		do {
-			const T *const old_ptr = reinterpret_cast<const T *>(regions[r].data.get());
-			const T *const new_ptr = reinterpret_cast<const T *>(new_region.data.get());
-			const size_t count = regions[r].length / sizeof(T);
-			// Puts the absolute address into something that can be indexed into the arrays of type T.
-			const size_t translated_index = (valid_addresses[a] - regions[r].base_address) / sizeof(T);
-			if (keep_if(old_ptr[translated_index], new_ptr[translated_index])) {
-				found_at_least_one_valid_address = true;
-				// Keep this address by swapping to front. Only swap if it isn't in the correct position.
-				if (new_size_a != a) {
-					std::swap(valid_addresses[new_size_a], valid_addresses[a]);
-				}
-				++new_size_a;
-			}
-			// Move onto next addresses.
-			++a;
-		} while (a < valid_addresses.size() && regions[r].ContainsAddress(valid_addresses[a]));
+		const size_t kept =
+			ScanRegionCandidates<T>(process, regions[r], &valid_addresses[a], end_a - a, keep_if, tuning);
+		// Keep the passing addresses by moving them to the front. The destination never overlaps unread addresses.
+		for (size_t i = 0; i < kept; ++i) {
+			valid_addresses[new_size_a + i] = valid_addresses[a + i];
+		}
+		new_size_a += kept;
+		a = end_a;
 		// If no address passes filter at this region then it will be discarded.
-		if (found_at_least_one_valid_address) {
-			// Replace memory region with the new one.
-			regions[r] = std::move(new_region);
+		if (kept != 0) {
 			// Keep this region by swapping to front. Only swap if it isn't in the correct position.
 			if (new_size_r != r) {
 				std::swap(regions[new_size_r], regions[r]);
@@ -181,16 +438,8 @@ void NextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<In
 template<typename T>
 void MemoryObject<T>::ReRead(HANDLE process)
 {
-	SIZE_T bytes_read = 0;
-	void *ptr = reinterpret_cast<void *>(address);
 	char *dest = reinterpret_cast<char *>(&value);
-	if (!ReadProcessMemory(process, ptr, dest, sizeof(T), &bytes_read)) {
-		const DWORD ec = GetLastError();
-		if (ec != ERROR_PARTIAL_COPY) {
-			throw MemoryScannerException("Cannot read process memory", ec, ptr);
-		}
-	}
-	if (bytes_read != sizeof(T)) {
+	if (ReadMemory(process, address, dest, sizeof(T)) != sizeof(T)) {
 		throw MemoryScannerException("Bytes read differs from memory object size");
 	}
 }
@@ -0,0 +1,74 @@
+#include "module_map.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+#include <TlHelp32.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cwctype>
+#include <string>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+namespace
+{
+
+bool NamesEqualIgnoreCase(const std::wstring &a, const std::wstring &b)
+{
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+		[](const wchar_t x, const wchar_t y) { return std::towlower(x) == std::towlower(y); });
+}
+
+}  // namespace
+
+std::vector<ModuleInfo> EnumerateModules(HANDLE process)
+{
+	const DWORD pid = GetProcessId(process);
+	if (pid == 0) {
+		const DWORD ec = GetLastError();
+		throw MemoryScannerException("Cannot get process id from handle", ec);
+	}
+	HANDLE snapshot = INVALID_HANDLE_VALUE;
+	// The snapshot can spuriously fail while the process is loading or unloading a module, so retry a few times.
+	for (int attempt = 0; attempt < 8; ++attempt) {
+		snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE | TH32CS_SNAPMODULE32, pid);
+		if (snapshot != INVALID_HANDLE_VALUE || GetLastError() != ERROR_BAD_LENGTH) {
+			break;
+		}
+	}
+	if (snapshot == INVALID_HANDLE_VALUE) {
+		const DWORD ec = GetLastError();
+		throw MemoryScannerException("Cannot snapshot process modules", ec);
+	}
+	std::vector<ModuleInfo> modules;
+	MODULEENTRY32W entry;
+	entry.dwSize = sizeof(entry);
+	for (BOOL ok = Module32FirstW(snapshot, &entry); ok; ok = Module32NextW(snapshot, &entry)) {
+		ModuleInfo module;
+		module.name = entry.szModule;
+		module.base_address = reinterpret_cast<IntPtr>(entry.modBaseAddr);
+		module.length = entry.modBaseSize;
+		modules.push_back(std::move(module));
+	}
+	CloseHandle(snapshot);
+	std::sort(modules.begin(), modules.end(),
+		[](const ModuleInfo &a, const ModuleInfo &b) { return a.base_address < b.base_address; });
+	return modules;
+}
+
+size_t FindModuleByName(const std::vector<ModuleInfo> &modules, const std::wstring &name)
+{
+	for (size_t i = 0; i < modules.size(); ++i) {
+		if (NamesEqualIgnoreCase(modules[i].name, name)) {
+			return i;
+		}
+	}
+	return modules.size();
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,49 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "memory_scanner.hpp"
+
+namespace memory_scanner
+{
+
+// A module (exe or dll) loaded into a process.
+class ModuleInfo
+{
+public:
+	std::wstring name;
+	IntPtr base_address = 0;
+	IntPtr length = 0;
+
+	bool ContainsAddress(const IntPtr address) const
+	{
+		return address >= base_address && address < (base_address + length);
+	}
+};
+
+// An address expressed relative to a module, which stays the same between runs of the same executable even when
+// ASLR loads the module somewhere else.
+class ModuleOffset
+{
+public:
+	// Index into the vector of `ModuleInfo`s the offset was made from.
+	std::uint32_t module_index = 0;
+	IntPtr offset = 0;
+
+	bool operator==(const ModuleOffset &) const = default;
+};
+
+// Lists the modules loaded into the process, sorted from lowest base address to highest base address.
+std::vector<ModuleInfo> EnumerateModules(HANDLE process);
+
+// Returns the index of the module in `modules` with the same name, compared case-insensitively like the loader does,
+// or `modules.size()` if there is none.
+size_t FindModuleByName(const std::vector<ModuleInfo> &modules, const std::wstring &name);
+
+}  // namespace memory_scanner
@@ -0,0 +1,262 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "memory_scanner.hpp"
+#include "thread_pool.hpp"
+
+namespace memory_scanner
+{
+
+// The scan state of one process when scanning many processes at once.
+class ScanTarget
+{
+public:
+	HANDLE process = nullptr;
+	std::vector<MemoryRegion> regions;
+	// Sorted from lowest address to highest. Only meaningful once `has_candidates` is true.
+	std::vector<IntPtr> valid_addresses;
+	// False until the first `NextScanAll`, which considers every address in `regions`. Later scans only consider
+	// `valid_addresses`, the same as the restricted overload of `NextScan`.
+	bool has_candidates = false;
+};
+
+// The amount of region bytes a single task re-reads before yielding the worker to another target.
+constexpr IntPtr default_bytes_per_task = IntPtr(4) << 20;
+
+// Performs `InitialScan` on every target at once using the workers of `pool`, replacing the regions of every target and
+// clearing their candidates. Regions are read in tasks of roughly `bytes_per_task` bytes queued round-robin between the
+// workers, so with a pool pinned to NUMA nodes the buffers end up interleaved over the nodes.
+void InitialScanAll(WorkStealingPool &pool, std::vector<ScanTarget> &targets,
+	const InitialScanOptions &options = InitialScanOptions(), IntPtr bytes_per_task = default_bytes_per_task);
+
+// The reading half of `InitialScanAll`: reads the regions every target already has, as set up by `QueryRegions`,
+// `CoalesceRegions` and `SetBoundaryOverlaps`, and clears their candidates. Lets the regions be queried ahead of time,
+// for example before the targets are frozen.
+void ReadTargetSpans(WorkStealingPool &pool, std::vector<ScanTarget> &targets,
+	IntPtr bytes_per_task = default_bytes_per_task);
+
+// Performs `NextScan` on every target at once using the workers of `pool`. Each target's regions are cut into tasks of
+// roughly `bytes_per_task` bytes and the tasks are queued round-robin between targets, so every target gets an equal
+// share of the workers regardless of how large the other targets are. The results for each target are exactly what
+// `NextScan` would have produced. `keep_if` is called concurrently from several workers. If a task throws then the
+// first exception is rethrown once all tasks have finished, and the targets should be considered garbage. Each task is
+// queued on a worker of the NUMA node holding the buffer of its first region. `tuning` applies to the restricted scans
+// of the regions, like with the restricted `NextScan`.
+template<typename T, typename Filter = FilterFn<T>>
+void NextScanAll(WorkStealingPool &pool, std::vector<ScanTarget> &targets, const Filter &keep_if,
+	IntPtr bytes_per_task = default_bytes_per_task, const ScanTuning &tuning = ScanTuning());
+
+//
+// Implementations of templated functions below...
+//
+
+namespace internal
+{
+
+// The work for one target, split into tasks.
+class TargetScanPlan
+{
+public:
+	// Each task covers the regions [first, second).
+	std::vector<std::pair<size_t, size_t>> tasks;
+	// Per region, the range of `valid_addresses` it contains. Only used for restricted scans.
+	std::vector<size_t> candidate_begin;
+	std::vector<size_t> candidate_count;
+	// Per region, whether the region survives the scan.
+	std::vector<char> keep_region;
+	// Per task, the addresses found. Only used for unrestricted scans.
+	std::vector<std::vector<IntPtr>> task_addresses;
+};
+
+inline TargetScanPlan PlanTargetScan(const ScanTarget &target, const IntPtr bytes_per_task)
+{
+	TargetScanPlan plan;
+	const std::vector<MemoryRegion> &regions = target.regions;
+	plan.keep_region.resize(regions.size(), 0);
+	if (target.has_candidates) {
+		// Candidates outside of every region cannot be read and are dropped, like the restricted `NextScan` does.
+		GroupCandidates(regions, target.valid_addresses, plan.candidate_begin, plan.candidate_count);
+	}
+	size_t task_begin = 0;
+	IntPtr task_bytes = 0;
+	for (size_t r = 0; r < regions.size(); ++r) {
+		// Regions without candidates are never read, so they do not count toward the budget.
+		if (target.has_candidates && plan.candidate_count[r] == 0) {
+			continue;
+		}
+		task_bytes += regions[r].length;
+		if (task_bytes >= bytes_per_task) {
+			plan.tasks.emplace_back(task_begin, r + 1);
+			task_begin = r + 1;
+			task_bytes = 0;
+		}
+	}
+	if (task_bytes != 0) {
+		plan.tasks.emplace_back(task_begin, regions.size());
+	}
+	plan.task_addresses.resize(target.has_candidates ? 0 : plan.tasks.size());
+	return plan;
+}
+
+// Removes the regions and addresses that did not survive, keeping everything in order.
+inline void ApplyTargetScanPlan(ScanTarget &target, TargetScanPlan &plan)
+{
+	std::vector<MemoryRegion> &regions = target.regions;
+	std::vector<IntPtr> &valid_addresses = target.valid_addresses;
+	size_t new_size_r = 0;
+	size_t new_size_a = 0;
+	for (size_t r = 0; r < regions.size(); ++r) {
+		if (!plan.keep_region[r]) {
+			continue;
+		}
+		if (target.has_candidates) {
+			// The survivors were already moved to the front of this region's candidate range.
+			const size_t begin = plan.candidate_begin[r];
+			for (size_t i = 0; i < plan.candidate_count[r]; ++i) {
+				valid_addresses[new_size_a + i] = valid_addresses[begin + i];
+			}
+			new_size_a += plan.candidate_count[r];
+		}
+		if (new_size_r != r) {
+			std::swap(regions[new_size_r], regions[r]);
+		}
+		++new_size_r;
+	}
+	regions.resize(new_size_r);
+	if (target.has_candidates) {
+		valid_addresses.resize(new_size_a);
+		return;
+	}
+	valid_addresses.clear();
+	for (const std::vector<IntPtr> &addresses : plan.task_addresses) {
+		valid_addresses.insert(valid_addresses.end(), addresses.begin(), addresses.end());
+	}
+	target.has_candidates = true;
+}
+
+// Returns the worker a task over `regions[first]` onward should be queued on.
+inline unsigned PickWorker(WorkStealingPool &pool, const std::vector<MemoryRegion> &regions, const size_t first)
+{
+	return pool.WorkerForNumaNode(regions[first].data.get_deleter().numa_node);
+}
+
+}  // namespace internal
+
+inline void InitialScanAll(WorkStealingPool &pool, std::vector<ScanTarget> &targets,
+	const InitialScanOptions &options, const IntPtr bytes_per_task)
+{
+	for (ScanTarget &target : targets) {
+		target.regions = QueryRegions(target.process, 0, ~IntPtr(0));
+		CoalesceRegions(target.regions, options.max_span_length);
+		SetBoundaryOverlaps(target.regions, options.boundary_overlap);
+	}
+	ReadTargetSpans(pool, targets, bytes_per_task);
+}
+
+inline void ReadTargetSpans(WorkStealingPool &pool, std::vector<ScanTarget> &targets, const IntPtr bytes_per_task)
+{
+	std::vector<internal::TargetScanPlan> plans;
+	plans.reserve(targets.size());
+	// Per target and region, the pieces of a span that had to be read piece by piece. Usually empty.
+	std::vector<std::vector<std::vector<MemoryRegion>>> pieces(targets.size());
+	size_t most_tasks = 0;
+	for (size_t t = 0; t < targets.size(); ++t) {
+		ScanTarget &target = targets[t];
+		target.valid_addresses.clear();
+		target.has_candidates = false;
+		plans.push_back(internal::PlanTargetScan(target, bytes_per_task));
+		pieces[t].resize(target.regions.size());
+		most_tasks = std::max(most_tasks, plans.back().tasks.size());
+	}
+	for (size_t i = 0; i < most_tasks; ++i) {
+		for (size_t t = 0; t < targets.size(); ++t) {
+			if (i >= plans[t].tasks.size()) {
+				continue;
+			}
+			pool.Submit([&target = targets[t], &target_pieces = pieces[t], task = plans[t].tasks[i]] {
+				for (size_t r = task.first; r < task.second; ++r) {
+					std::vector<MemoryRegion> read = ReadSpan(target.process, std::move(target.regions[r]));
+					if (read.size() == 1) {
+						target.regions[r] = std::move(read[0]);
+					} else {
+						target_pieces[r] = std::move(read);
+					}
+				}
+			});
+		}
+	}
+	pool.Wait();
+
+	// Splice in the pieces of spans that could not be read whole.
+	for (size_t t = 0; t < targets.size(); ++t) {
+		std::vector<MemoryRegion> &regions = targets[t].regions;
+		std::vector<MemoryRegion> merged;
+		merged.reserve(regions.size());
+		for (size_t r = 0; r < regions.size(); ++r) {
+			if (pieces[t][r].empty()) {
+				if (regions[r].data != nullptr) {
+					merged.push_back(std::move(regions[r]));
+				}
+				continue;
+			}
+			for (MemoryRegion &piece : pieces[t][r]) {
+				merged.push_back(std::move(piece));
+			}
+		}
+		regions = std::move(merged);
+	}
+}
+
+template<typename T, typename Filter>
+void NextScanAll(WorkStealingPool &pool, std::vector<ScanTarget> &targets, const Filter &keep_if,
+	const IntPtr bytes_per_task, const ScanTuning &tuning)
+{
+	std::vector<internal::TargetScanPlan> plans;
+	plans.reserve(targets.size());
+	size_t most_tasks = 0;
+	for (const ScanTarget &target : targets) {
+		plans.push_back(internal::PlanTargetScan(target, bytes_per_task));
+		most_tasks = std::max(most_tasks, plans.back().tasks.size());
+	}
+	// Deal out the tasks one target at a time so that a large target cannot starve the others.
+	for (size_t i = 0; i < most_tasks; ++i) {
+		for (size_t t = 0; t < targets.size(); ++t) {
+			if (i >= plans[t].tasks.size()) {
+				continue;
+			}
+			const unsigned worker = internal::PickWorker(pool, targets[t].regions, plans[t].tasks[i].first);
+			pool.Submit(worker, [&target = targets[t], &plan = plans[t], &keep_if, &tuning, i] {
+				const auto [begin, end] = plan.tasks[i];
+				for (size_t r = begin; r < end; ++r) {
+					MemoryRegion &region = target.regions[r];
+					if (!target.has_candidates) {
+						plan.keep_region[r] = ScanRegion<T>(target.process, region, keep_if, plan.task_addresses[i]);
+						continue;
+					}
+					if (plan.candidate_count[r] == 0) {
+						continue;
+					}
+					IntPtr *const candidates = &target.valid_addresses[plan.candidate_begin[r]];
+					plan.candidate_count[r] = ScanRegionCandidates<T>(target.process, region, candidates,
+						plan.candidate_count[r], keep_if, tuning);
+					plan.keep_region[r] = plan.candidate_count[r] != 0;
+				}
+			});
+		}
+	}
+	pool.Wait();
+
+	for (size_t t = 0; t < targets.size(); ++t) {
+		internal::ApplyTargetScanPlan(targets[t], plans[t]);
+	}
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,46 @@
+#include "numa.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+namespace
+{
+
+thread_local DWORD current_thread_numa_node = NUMA_NO_PREFERRED_NODE;
+
+}  // namespace
+
+unsigned NumaNodeCount()
+{
+	ULONG highest_node = 0;
+	if (!GetNumaHighestNodeNumber(&highest_node)) {
+		return 1;
+	}
+	return static_cast<unsigned>(highest_node) + 1;
+}
+
+void PinCurrentThreadToNumaNode(const DWORD node)
+{
+	GROUP_AFFINITY affinity = {};
+	if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity)) {
+		const DWORD ec = GetLastError();
+		throw MemoryScannerException("Cannot get processors of NUMA node", ec);
+	}
+	if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr)) {
+		const DWORD ec = GetLastError();
+		throw MemoryScannerException("Cannot pin thread to NUMA node", ec);
+	}
+	current_thread_numa_node = node;
+}
+
+DWORD CurrentThreadNumaNode()
+{
+	return current_thread_numa_node;
+}
+
+}  // namespace memory_scanner
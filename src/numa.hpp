@@ -0,0 +1,20 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+namespace memory_scanner
+{
+
+// Returns the number of NUMA nodes on the machine, which is 1 on machines without NUMA.
+unsigned NumaNodeCount();
+
+// Restricts the calling thread to the processors of `node` and remembers the node so that region buffers the thread
+// allocates afterwards through `ReadRegionData` are bound to it.
+void PinCurrentThreadToNumaNode(DWORD node);
+
+// Returns the node the calling thread was pinned to with `PinCurrentThreadToNumaNode`, or NUMA_NO_PREFERRED_NODE.
+DWORD CurrentThreadNumaNode();
+
+}  // namespace memory_scanner
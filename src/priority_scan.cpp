@@ -0,0 +1,57 @@
+#include "priority_scan.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+namespace memory_scanner
+{
+
+std::vector<RegionKind> ClassifyRegions(const std::vector<MemoryRegion> &regions)
+{
+	std::vector<RegionKind> kinds;
+	kinds.reserve(regions.size());
+	for (const MemoryRegion &region : regions) {
+		if (region.type == MEM_IMAGE) {
+			kinds.push_back(RegionKind::ModuleData);
+		} else if (region.type == MEM_PRIVATE) {
+			kinds.push_back(RegionKind::Heap);
+		} else {
+			kinds.push_back(RegionKind::Other);
+		}
+	}
+	return kinds;
+}
+
+std::vector<size_t> OrderByKind(const std::vector<RegionKind> &kinds)
+{
+	std::vector<size_t> order(kinds.size());
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(),
+		[&kinds](const size_t a, const size_t b) { return kinds[a] < kinds[b]; });
+	return order;
+}
+
+std::vector<size_t> OrderByHitDensity(const std::vector<MemoryRegion> &regions,
+	const std::vector<IntPtr> &valid_addresses)
+{
+	std::vector<size_t> begin;
+	std::vector<size_t> count;
+	internal::GroupCandidates(regions, valid_addresses, begin, count);
+	std::vector<double> density(regions.size(), 0);
+	for (size_t r = 0; r < regions.size(); ++r) {
+		density[r] = regions[r].length == 0 ? 0 : static_cast<double>(count[r]) / regions[r].length;
+	}
+	std::vector<size_t> order(regions.size());
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(),
+		[&density](const size_t a, const size_t b) { return density[a] > density[b]; });
+	return order;
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,129 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "memory_scanner.hpp"
+
+namespace memory_scanner
+{
+
+// What a region of memory is used for, from most to least likely to hold the values of an interactive hunt.
+enum class RegionKind : std::uint8_t {
+	// Writable sections of an exe or dll, holding globals such as `.data` and `.bss`.
+	ModuleData,
+	// Private allocations: heaps, stacks and the like.
+	Heap,
+	// Everything else, such as mapped files and shared memory.
+	Other,
+};
+
+// Returns the kind of each region from the memory type `QueryRegions` recorded, so it matches the snapshot without
+// asking the process again. Regions that were not queried are `Other`.
+std::vector<RegionKind> ClassifyRegions(const std::vector<MemoryRegion> &regions);
+
+// Returns the indices of the regions ordered by kind, in address order within a kind.
+std::vector<size_t> OrderByKind(const std::vector<RegionKind> &kinds);
+
+// Returns the indices of the regions ordered by how many of `valid_addresses` each holds per byte, densest first.
+// Regions without any come last, in address order. Both vectors must be sorted from low to high.
+std::vector<size_t> OrderByHitDensity(const std::vector<MemoryRegion> &regions,
+	const std::vector<IntPtr> &valid_addresses);
+
+// Same as `NextScan<T>`, but scans the regions in `order`, a permutation of the region indices such as one returned by
+// `OrderByKind`, and calls `on_results(addresses, count)` with the addresses found in each region as soon as it is
+// scanned and anything passed, so the likeliest hits show up early. The returned addresses and the remaining regions
+// are the same as with `NextScan<T>`, sorted from low to high.
+template<typename T, typename Filter, typename OnResults>
+std::vector<IntPtr> PriorityNextScan(HANDLE process, std::vector<MemoryRegion> &regions,
+	const std::vector<size_t> &order, const Filter &keep_if, OnResults &&on_results);
+
+// Same as above, but restricted to `valid_addresses` like the restricted `NextScan<T>`, with the same results.
+template<typename T, typename Filter, typename OnResults>
+void PriorityNextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses,
+	const std::vector<size_t> &order, const Filter &keep_if, OnResults &&on_results,
+	const ScanTuning &tuning = ScanTuning());
+
+//
+// Implementations of templated functions below...
+//
+
+namespace internal
+{
+
+// Removes the regions that are not marked in `keep`, preserving the order of the others.
+inline void KeepRegions(std::vector<MemoryRegion> &regions, const std::vector<char> &keep)
+{
+	size_t new_size = 0;
+	for (size_t r = 0; r < regions.size(); ++r) {
+		if (!keep[r]) {
+			continue;
+		}
+		if (new_size != r) {
+			std::swap(regions[new_size], regions[r]);
+		}
+		++new_size;
+	}
+	regions.resize(new_size);
+}
+
+}  // namespace internal
+
+template<typename T, typename Filter, typename OnResults>
+std::vector<IntPtr> PriorityNextScan(HANDLE process, std::vector<MemoryRegion> &regions,
+	const std::vector<size_t> &order, const Filter &keep_if, OnResults &&on_results)
+{
+	std::vector<std::vector<IntPtr>> found(regions.size());
+	std::vector<char> keep(regions.size(), 0);
+	for (const size_t r : order) {
+		keep[r] = ScanRegion<T>(process, regions[r], keep_if, found[r]);
+		if (keep[r]) {
+			on_results(found[r].data(), found[r].size());
+		}
+	}
+	std::vector<IntPtr> valid_addresses;
+	for (const std::vector<IntPtr> &addresses : found) {
+		valid_addresses.insert(valid_addresses.end(), addresses.begin(), addresses.end());
+	}
+	internal::KeepRegions(regions, keep);
+	return valid_addresses;
+}
+
+template<typename T, typename Filter, typename OnResults>
+void PriorityNextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses,
+	const std::vector<size_t> &order, const Filter &keep_if, OnResults &&on_results, const ScanTuning &tuning)
+{
+	std::vector<size_t> begin;
+	std::vector<size_t> count;
+	internal::GroupCandidates(regions, valid_addresses, begin, count);
+	// The passing addresses of each region are moved to the front of its range, so the ranges never overlap.
+	std::vector<size_t> kept(regions.size(), 0);
+	for (const size_t r : order) {
+		if (count[r] == 0) {
+			continue;
+		}
+		kept[r] = ScanRegionCandidates<T>(process, regions[r], &valid_addresses[begin[r]], count[r], keep_if, tuning);
+		if (kept[r] != 0) {
+			on_results(&valid_addresses[begin[r]], kept[r]);
+		}
+	}
+	std::vector<char> keep(regions.size(), 0);
+	size_t new_size_a = 0;
+	for (size_t r = 0; r < regions.size(); ++r) {
+		for (size_t i = 0; i < kept[r]; ++i) {
+			valid_addresses[new_size_a + i] = valid_addresses[begin[r] + i];
+		}
+		new_size_a += kept[r];
+		keep[r] = kept[r] != 0;
+	}
+	valid_addresses.resize(new_size_a);
+	internal::KeepRegions(regions, keep);
+}
+
+}  // namespace memory_scanner
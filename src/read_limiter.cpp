@@ -0,0 +1,159 @@
+#include "read_limiter.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+namespace
+{
+
+// Identifies a process across handles. Ids are reused once a process exits, the creation time tells the processes
+// apart.
+class ProcessKey
+{
+public:
+	DWORD pid = 0;
+	std::uint64_t created = 0;
+
+	bool operator==(const ProcessKey &) const = default;
+};
+
+// Returns false if `process` lacks the rights to query it.
+bool GetProcessKey(HANDLE process, ProcessKey &key)
+{
+	key.pid = GetProcessId(process);
+	FILETIME created;
+	FILETIME exited;
+	FILETIME kernel;
+	FILETIME user;
+	if (key.pid == 0 || !GetProcessTimes(process, &created, &exited, &kernel, &user)) {
+		return false;
+	}
+	key.created = (static_cast<std::uint64_t>(created.dwHighDateTime) << 32) | created.dwLowDateTime;
+	return true;
+}
+
+class LimiterRegistry
+{
+public:
+	std::mutex mutex;
+	// Keyed by process, so every handle to the same process shares its limiter.
+	std::vector<std::pair<ProcessKey, std::shared_ptr<ReadLimiter>>> limiters;
+	// Lets reads skip the lock while no limiter is set, which is the common case.
+	std::atomic<bool> any = false;
+};
+
+LimiterRegistry &Registry()
+{
+	static LimiterRegistry registry;
+	return registry;
+}
+
+}  // namespace
+
+double ReadLimiterStats::BytesPerSecond() const
+{
+	const double seconds = std::chrono::duration<double>(elapsed).count();
+	return seconds > 0 ? bytes_read / seconds : 0;
+}
+
+ReadLimiter::ReadLimiter(const ReadBudget &budget)
+	: budget(budget), created(Clock::now()), tokens(static_cast<double>(budget.burst_bytes)), refilled(created)
+{
+	if (!(budget.bytes_per_second > 0) || budget.max_concurrent_reads == 0 || budget.max_read_size == 0) {
+		throw MemoryScannerException("Read budget must allow some reading");
+	}
+}
+
+void ReadLimiter::Acquire(const IntPtr bytes)
+{
+	std::unique_lock lock(mutex);
+	const Clock::time_point start = Clock::now();
+	slot_free.wait(lock, [this] { return reads_in_flight < budget.max_concurrent_reads; });
+	++reads_in_flight;
+	const Clock::time_point now = Clock::now();
+	const double refill = std::chrono::duration<double>(now - refilled).count() * budget.bytes_per_second;
+	tokens = std::min(tokens + refill, static_cast<double>(budget.burst_bytes));
+	refilled = now;
+	tokens -= static_cast<double>(bytes);
+	const auto debt = std::chrono::duration<double>(tokens < 0 ? -tokens / budget.bytes_per_second : 0);
+	const Clock::duration wait = std::chrono::duration_cast<Clock::duration>(debt);
+	stats.throttled += (now - start) + wait;
+	lock.unlock();
+	if (wait > Clock::duration::zero()) {
+		std::this_thread::sleep_for(wait);
+	}
+}
+
+void ReadLimiter::Release(const SIZE_T bytes_read)
+{
+	{
+		const std::lock_guard lock(mutex);
+		--reads_in_flight;
+		stats.bytes_read += bytes_read;
+		++stats.reads;
+	}
+	slot_free.notify_one();
+}
+
+ReadLimiterStats ReadLimiter::Stats() const
+{
+	const std::lock_guard lock(mutex);
+	ReadLimiterStats result = stats;
+	result.elapsed = Clock::now() - created;
+	return result;
+}
+
+void SetReadLimiter(HANDLE process, std::shared_ptr<ReadLimiter> limiter)
+{
+	ProcessKey key;
+	if (!GetProcessKey(process, key)) {
+		const DWORD ec = GetLastError();
+		throw MemoryScannerException("Cannot identify process from handle", ec);
+	}
+	LimiterRegistry &registry = Registry();
+	const std::lock_guard lock(registry.mutex);
+	auto &limiters = registry.limiters;
+	std::erase_if(limiters, [&key](const auto &entry) { return entry.first == key; });
+	if (limiter != nullptr) {
+		limiters.emplace_back(key, std::move(limiter));
+	}
+	registry.any = !limiters.empty();
+}
+
+std::shared_ptr<ReadLimiter> GetReadLimiter(HANDLE process)
+{
+	LimiterRegistry &registry = Registry();
+	// Every ReadMemory asks, so only identify the process once some limiter is set.
+	if (!registry.any) {
+		return nullptr;
+	}
+	// Handles without the rights to query the process have no limiter.
+	ProcessKey key;
+	if (!GetProcessKey(process, key)) {
+		return nullptr;
+	}
+	const std::lock_guard lock(registry.mutex);
+	for (const auto &[limited, limiter] : registry.limiters) {
+		if (limited == key) {
+			return limiter;
+		}
+	}
+	return nullptr;
+}
+
+}  // namespace memory_scanner
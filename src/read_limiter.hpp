@@ -0,0 +1,84 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "memory_scanner.hpp"
+
+namespace memory_scanner
+{
+
+// How much reading a `ReadLimiter` allows.
+class ReadBudget
+{
+public:
+	double bytes_per_second = double(64 << 20);
+	// The most bytes that can be read at full speed after the limiter was idle.
+	IntPtr burst_bytes = IntPtr(4) << 20;
+	// The most reads in flight at once, across every thread.
+	unsigned max_concurrent_reads = 1;
+	// Larger reads are split into reads of this many bytes, so a region does not reach the target as one long burst.
+	IntPtr max_read_size = IntPtr(1) << 20;
+};
+
+class ReadLimiterStats
+{
+public:
+	std::uint64_t bytes_read = 0;
+	std::uint64_t reads = 0;
+	// The total time reads waited for the budget, summed over threads.
+	std::chrono::steady_clock::duration throttled{};
+	// The time since the limiter was created.
+	std::chrono::steady_clock::duration elapsed{};
+
+	double BytesPerSecond() const;
+};
+
+// A token bucket capping the rate and concurrency of reads from a process, so background scans can run continuously
+// without hurting the latency of the target. Tokens are bytes, refilled at `bytes_per_second` up to `burst_bytes`. A
+// read takes its bytes up front, possibly going into debt, and waits until the debt is paid off. Safe to share between
+// threads.
+class ReadLimiter
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit ReadLimiter(const ReadBudget &budget);
+
+	// Blocks until a read of `bytes` fits the budget. Every Acquire must be followed by a Release.
+	void Acquire(IntPtr bytes);
+
+	// Ends a read started with Acquire, which read `bytes_read` bytes.
+	void Release(SIZE_T bytes_read);
+
+	IntPtr MaxReadSize() const { return budget.max_read_size; }
+
+	ReadLimiterStats Stats() const;
+
+private:
+	const ReadBudget budget;
+	const Clock::time_point created;
+	mutable std::mutex mutex;
+	std::condition_variable slot_free;
+	unsigned reads_in_flight = 0;
+	double tokens;
+	Clock::time_point refilled;
+	ReadLimiterStats stats;
+};
+
+// Makes every `ReadMemory` from `process`, and so every scan of it, go through `limiter`. Passing nullptr removes the
+// limiter. Reads from processes without a limiter are not slowed down. The limiter applies to every handle to the same
+// process, looked up by process id and creation time, so a later process reusing the id is not limited.
+void SetReadLimiter(HANDLE process, std::shared_ptr<ReadLimiter> limiter);
+
+// Returns the limiter set for `process`, or nullptr.
+std::shared_ptr<ReadLimiter> GetReadLimiter(HANDLE process);
+
+}  // namespace memory_scanner
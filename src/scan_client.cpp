@@ -0,0 +1,137 @@
+#include "scan_client.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+namespace
+{
+
+MessageWriter MakeRequest(const RequestType type, const std::uint32_t target)
+{
+	MessageWriter request;
+	request.Put(type);
+	request.Put(target);
+	return request;
+}
+
+}  // namespace
+
+ScanClient::ScanClient(const std::wstring &pipe_name)
+{
+	for (;;) {
+		pipe = CreateFileW(pipe_name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+		if (pipe != INVALID_HANDLE_VALUE) {
+			break;
+		}
+		// Every instance of the pipe is taken until the daemon creates the next one.
+		const DWORD ec = GetLastError();
+		if (ec != ERROR_PIPE_BUSY || !WaitNamedPipeW(pipe_name.c_str(), 5000)) {
+			throw MemoryScannerException("Cannot connect to scan daemon", ec);
+		}
+	}
+}
+
+ScanClient::~ScanClient()
+{
+	CloseHandle(pipe);
+}
+
+MessageReader ScanClient::Call(const MessageWriter &request)
+{
+	WriteMessage(pipe, request.bytes);
+	if (!ReadMessage(pipe, reply)) {
+		throw MemoryScannerException("Scan daemon closed the connection");
+	}
+	MessageReader reader(reply);
+	if (reader.Get<ReplyStatus>() != ReplyStatus::Ok) {
+		throw MemoryScannerException(reader.GetString());
+	}
+	return reader;
+}
+
+std::uint32_t ScanClient::Attach(const DWORD pid)
+{
+	return Call(MakeRequest(RequestType::Attach, pid)).Get<std::uint32_t>();
+}
+
+void ScanClient::Detach(const std::uint32_t target)
+{
+	Call(MakeRequest(RequestType::Detach, target));
+}
+
+std::uint64_t ScanClient::InitialScan(const std::uint32_t target)
+{
+	MessageReader reader = Call(MakeRequest(RequestType::InitialScan, target));
+	reader.Get<std::uint64_t>();
+	return reader.Get<std::uint64_t>();
+}
+
+std::uint64_t ScanClient::NextScan(const std::uint32_t target, const ScanType type, const CompareOp op,
+	const ScanValue &value)
+{
+	MessageWriter request = MakeRequest(RequestType::NextScan, target);
+	request.Put(type);
+	request.Put(op);
+	request.Put(value);
+	return Call(request).Get<std::uint64_t>();
+}
+
+std::vector<IntPtr> ScanClient::Candidates(const std::uint32_t target)
+{
+	MessageReader reader = Call(MakeRequest(RequestType::Candidates, target));
+	std::vector<IntPtr> addresses(reader.Get<std::uint64_t>());
+	// The daemon duplicated the handle into this process.
+	const HANDLE mapping = reinterpret_cast<HANDLE>(static_cast<std::uintptr_t>(reader.Get<std::uint64_t>()));
+	if (addresses.empty()) {
+		return addresses;
+	}
+	const size_t size = addresses.size() * sizeof(IntPtr);
+	const void *const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+	if (view == nullptr) {
+		const DWORD ec = GetLastError();
+		CloseHandle(mapping);
+		throw MemoryScannerException("Cannot map result mapping", ec);
+	}
+	std::memcpy(addresses.data(), view, size);
+	UnmapViewOfFile(view);
+	CloseHandle(mapping);
+	return addresses;
+}
+
+void ScanClient::Watch(const std::uint32_t target, const IntPtr address, const size_t size)
+{
+	MessageWriter request = MakeRequest(RequestType::Watch, target);
+	request.Put(static_cast<std::uint64_t>(address));
+	request.Put(static_cast<std::uint8_t>(size));
+	Call(request);
+}
+
+std::vector<ValueChange> ScanClient::PollChanges(const std::uint32_t target)
+{
+	MessageReader reader = Call(MakeRequest(RequestType::PollChanges, target));
+	std::vector<ValueChange> changes(reader.Get<std::uint32_t>());
+	for (ValueChange &change : changes) {
+		change.address = reader.Get<std::uint64_t>();
+		change.size = reader.Get<std::uint8_t>();
+		change.old_value = reader.Get<std::uint64_t>();
+		change.new_value = reader.Get<std::uint64_t>();
+		const std::chrono::nanoseconds since_epoch(reader.Get<std::int64_t>());
+		change.time = std::chrono::steady_clock::time_point(
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(since_epoch));
+	}
+	return changes;
+}
+
+}  // namespace memory_scanner
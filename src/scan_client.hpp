@@ -0,0 +1,64 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "address_watcher.hpp"
+#include "memory_scanner.hpp"
+#include "scan_protocol.hpp"
+#include "scan_types.hpp"
+#include "typed_scan.hpp"
+
+namespace memory_scanner
+{
+
+// A connection to `memory_scan_daemon`, for front-ends that want to share its snapshots, candidates and watches
+// instead of scanning on their own. Every call is one request answered by the daemon, whose errors are rethrown as
+// MemoryScannerException. A target is identified by its process id.
+class ScanClient
+{
+public:
+	explicit ScanClient(const std::wstring &pipe_name = default_pipe_name);
+	~ScanClient();
+
+	ScanClient(const ScanClient &) = delete;
+	ScanClient &operator=(const ScanClient &) = delete;
+
+	// Opens the process in the daemon unless it already is. Returns the target to use in the other calls.
+	std::uint32_t Attach(DWORD pid);
+
+	// Drops everything the daemon keeps for the target, for every client.
+	void Detach(std::uint32_t target);
+
+	// Replaces the snapshot of the target like `InitialScan` and forgets its candidates. Returns the bytes captured.
+	std::uint64_t InitialScan(std::uint32_t target);
+
+	// Filters the candidates of the target like the runtime typed `NextScan`, or the whole snapshot after an
+	// InitialScan. Returns the number of candidates left.
+	std::uint64_t NextScan(std::uint32_t target, ScanType type, CompareOp op, const ScanValue &value);
+
+	// Returns the candidates of the target, sorted from low to high. They arrive through shared memory, so a large set
+	// costs a single copy.
+	std::vector<IntPtr> Candidates(std::uint32_t target);
+
+	// Adds an address to the watch list of the target, see `AddressWatcher::Watch`.
+	void Watch(std::uint32_t target, IntPtr address, size_t size);
+
+	// Returns the changes of the watched addresses of the target since the last call by any client.
+	std::vector<ValueChange> PollChanges(std::uint32_t target);
+
+private:
+	// Sends the request and returns a reader positioned after the status of a successful reply.
+	MessageReader Call(const MessageWriter &request);
+
+	HANDLE pipe;
+	std::vector<char> reply;
+};
+
+}  // namespace memory_scanner
@@ -0,0 +1,82 @@
+// A long running scanner that keeps a snapshot, candidate set and watch list for every process its clients attach to,
+// so front-ends using `memory_scanner::ScanClient` share warm state instead of each scanning from scratch. Serves
+// `memory_scanner::default_pipe_name` to clients on the same machine, one thread per client.
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+#include "scan_protocol.hpp"
+#include "scan_service.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+
+// Large enough for most requests and replies, which are small. Bigger messages still work, in pieces.
+constexpr DWORD pipe_buffer_size = 64 << 10;
+
+void ServeClient(memory_scanner::ScanService &service, const HANDLE pipe)
+{
+	memory_scanner::ScanSession session;
+	// Without it the client still gets every reply but those handing over shared memory.
+	ULONG client_pid = 0;
+	if (GetNamedPipeClientProcessId(pipe, &client_pid)) {
+		session.client_process = OpenProcess(PROCESS_DUP_HANDLE, FALSE, client_pid);
+	}
+	std::vector<char> request;
+	try {
+		while (memory_scanner::ReadMessage(pipe, request)) {
+			memory_scanner::WriteMessage(pipe, service.Handle(request, session));
+		}
+	} catch (const std::exception &e) {
+		std::cout << "Dropping client: " << e.what() << std::endl;
+	}
+	DisconnectNamedPipe(pipe);
+	CloseHandle(pipe);
+}
+
+void Run()
+{
+	memory_scanner::WorkStealingPool pool;
+	memory_scanner::ScanService service(pool);
+	std::cout << "Serving" << std::endl;
+	for (;;) {
+		const HANDLE pipe = CreateNamedPipeW(memory_scanner::default_pipe_name, PIPE_ACCESS_DUPLEX,
+			PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES,
+			pipe_buffer_size, pipe_buffer_size, 0, nullptr);
+		if (pipe == INVALID_HANDLE_VALUE) {
+			const DWORD ec = GetLastError();
+			throw memory_scanner::MemoryScannerException("Cannot create pipe", ec);
+		}
+		// A client may connect between creating the pipe and waiting for it, which is reported as an error.
+		if (!ConnectNamedPipe(pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED) {
+			CloseHandle(pipe);
+			continue;
+		}
+		std::thread(ServeClient, std::ref(service), pipe).detach();
+	}
+}
+
+}  // namespace
+
+int main()
+{
+	static_assert(sizeof(void *) == 8, "You need to compile in 64 bit mode");
+
+	try {
+		Run();
+	} catch (memory_scanner::MemoryScannerException &e) {
+		std::cout << "\nFATAL" << std::endl;
+		std::cout << e.message << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+
+#include "scan_types.hpp"
+
+namespace memory_scanner
+{
+
+// Predicates that only look at the values they are given through LoadScalar, so that they may be given the values
+// themselves instead of the stored types.
+template<typename Pred>
+concept LoadsScalars = requires { requires Pred::loads_scalars; };
+
+// The number of elements the block kernels evaluate at once, one bit of a 64 bit mask per element.
+constexpr size_t kernel_block_size = 64;
+
+// Evaluates `pred(a[i], b[i])` for `n` elements (at most `kernel_block_size`) and returns a mask with bit i set if
+// element i passed. The predicate is evaluated for every element without branching on the result, which lets the
+// compiler vectorize the loop when `pred` is simple enough, so the predicate must be safe to call on any element. A
+// predicate with an `EvaluateBlock(a, b, n)` member returning the mask is handed the whole block instead. For
+// byte-swapped types, a predicate declaring `loads_scalars` (see `LoadsScalars`) is handed the block already converted
+// to native values, so that its comparisons vectorize.
+template<typename T, typename Pred>
+std::uint64_t EvaluateBlock(const T *a, const T *b, size_t n, const Pred &pred);
+
+// Calls `emit(i)` for every i in [0, count) where `pred(a[i], b[i])` holds, in increasing order of i.
+template<typename T, typename Pred, typename Emit>
+void ForEachMatch(const T *a, const T *b, size_t count, const Pred &pred, Emit &&emit);
+
+//
+// Implementations of templated functions below...
+//
+
+template<typename T, typename Pred>
+std::uint64_t EvaluateBlock(const T *const a, const T *const b, const size_t n, const Pred &pred)
+{
+	if constexpr (requires { { pred.EvaluateBlock(a, b, n) } -> std::convertible_to<std::uint64_t>; }) {
+		return pred.EvaluateBlock(a, b, n);
+	} else if constexpr (is_byte_swapped<T> && LoadsScalars<Pred>) {
+		Scalar<T> native_a[kernel_block_size];
+		Scalar<T> native_b[kernel_block_size];
+		LoadScalars(a, n, native_a);
+		LoadScalars(b, n, native_b);
+		return EvaluateBlock(native_a, native_b, n, pred);
+	} else {
+		bool lanes[kernel_block_size];
+		for (size_t i = 0; i < n; ++i) {
+			lanes[i] = pred(a[i], b[i]);
+		}
+		std::uint64_t mask = 0;
+		for (size_t i = 0; i < n; ++i) {
+			mask |= static_cast<std::uint64_t>(lanes[i]) << i;
+		}
+		return mask;
+	}
+}
+
+template<typename T, typename Pred, typename Emit>
+void ForEachMatch(const T *const a, const T *const b, const size_t count, const Pred &pred, Emit &&emit)
+{
+	for (size_t block = 0; block < count; block += kernel_block_size) {
+		const size_t n = std::min(kernel_block_size, count - block);
+		// Skipping the whole block is the common case since filters tend to be very selective.
+		for (std::uint64_t mask = EvaluateBlock(a + block, b + block, n, pred); mask != 0; mask &= mask - 1) {
+			emit(block + static_cast<size_t>(std::countr_zero(mask)));
+		}
+	}
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,193 @@
+#include "scan_planner.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+namespace
+{
+
+// Restricted scans sample at least this many candidates when there are that many.
+constexpr size_t min_candidate_sample = 1024;
+
+class SampleCounts
+{
+public:
+	explicit SampleCounts(const size_t clause_count) : passed(clause_count, 0) {}
+
+	std::vector<size_t> passed;
+	size_t combined = 0;
+	size_t total = 0;
+};
+
+template<typename T>
+void CountSample(const std::vector<ScanClause> &clauses, const T *const prev, const T *const cur, const size_t count,
+	SampleCounts &counts)
+{
+	for (size_t block = 0; block < count; block += kernel_block_size) {
+		const size_t n = std::min(kernel_block_size, count - block);
+		std::uint64_t combined = n == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << n) - 1;
+		for (size_t c = 0; c < clauses.size(); ++c) {
+			const std::uint64_t mask = internal::EvaluateClauseBlock(clauses[c], prev + block, cur + block, n);
+			counts.passed[c] += std::popcount(mask);
+			combined &= mask;
+		}
+		counts.combined += std::popcount(combined);
+	}
+	counts.total += count;
+}
+
+template<typename T>
+SampleCounts SampleRegions(HANDLE process, const std::vector<MemoryRegion> &regions,
+	const std::vector<ScanClause> &clauses, const ScanPlanOptions &options)
+{
+	SampleCounts counts(clauses.size());
+	const IntPtr chunk = std::max<IntPtr>(options.sample_chunk / sizeof(T), 1) * sizeof(T);
+	const IntPtr stride = std::max<IntPtr>(chunk, static_cast<IntPtr>(chunk / options.sample_fraction));
+	std::vector<T> sample(chunk / sizeof(T));
+	IntPtr region_start = 0;
+	IntPtr next = 0;
+	for (const MemoryRegion &region : regions) {
+		for (; next < region_start + region.length; next += stride) {
+			const IntPtr offset = (next - region_start) / sizeof(T) * sizeof(T);
+			const IntPtr length = std::min(chunk, region.length - offset) / sizeof(T) * sizeof(T);
+			if (length == 0) {
+				continue;
+			}
+			const SIZE_T bytes_read = ReadMemory(process, region.base_address + offset,
+				reinterpret_cast<char *>(sample.data()), length);
+			const T *const old_values = reinterpret_cast<const T *>(region.data.get() + offset);
+			CountSample(clauses, old_values, sample.data(), bytes_read / sizeof(T), counts);
+		}
+		region_start += region.length;
+	}
+	return counts;
+}
+
+template<typename T>
+SampleCounts SampleCandidates(HANDLE process, const std::vector<MemoryRegion> &regions,
+	const std::vector<IntPtr> &valid_addresses, const std::vector<ScanClause> &clauses, const ScanPlanOptions &options)
+{
+	SampleCounts counts(clauses.size());
+	const size_t wanted = std::max(std::min(valid_addresses.size(), min_candidate_sample),
+		static_cast<size_t>(valid_addresses.size() * options.sample_fraction));
+	if (wanted == 0) {
+		return counts;
+	}
+	const size_t step = std::max<size_t>(valid_addresses.size() / wanted, 1);
+	std::vector<T> old_values;
+	std::vector<T> new_values;
+	size_t r = 0;
+	for (size_t a = 0; a < valid_addresses.size(); a += step) {
+		const IntPtr address = valid_addresses[a];
+		r = internal::Gallop(regions.begin() + r, regions.end(), [address](const MemoryRegion &region) {
+			return region.base_address + region.length <= address;
+		}) - regions.begin();
+		if (r == regions.size()) {
+			// Every remaining candidate lies past the last region.
+			break;
+		}
+		if (!regions[r].ContainsAddress(address)) {
+			// Falls in a gap between regions, the next candidate may still be sampled.
+			continue;
+		}
+		const IntPtr offset = address - regions[r].base_address;
+		if (offset + sizeof(T) > regions[r].length + regions[r].overlap) {
+			continue;
+		}
+		T value;
+		if (ReadMemory(process, address, reinterpret_cast<char *>(&value), sizeof(T)) != sizeof(T)) {
+			continue;
+		}
+		T old_value;
+		std::memcpy(&old_value, regions[r].data.get() + offset, sizeof(T));
+		old_values.push_back(old_value);
+		new_values.push_back(value);
+	}
+	CountSample(clauses, old_values.data(), new_values.data(), old_values.size(), counts);
+	return counts;
+}
+
+// A fraction of 0 would sample nothing and one above 1 would read past the regions, so both are rejected.
+void CheckOptions(const ScanPlanOptions &options)
+{
+	if (!(options.sample_fraction > 0 && options.sample_fraction <= 1)) {
+		throw MemoryScannerException("Sample fraction must be greater than 0 and at most 1");
+	}
+}
+
+ScanPlan MakePlan(const ScanType type, const std::vector<ScanClause> &clauses, const SampleCounts &counts,
+	const ScanPlanOptions &options)
+{
+	const auto fraction = [&counts](const size_t passed) {
+		return counts.total == 0 ? 1.0 : static_cast<double>(passed) / counts.total;
+	};
+	std::vector<size_t> order(clauses.size());
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(),
+		[&counts](const size_t a, const size_t b) { return counts.passed[a] < counts.passed[b]; });
+	ScanPlan plan;
+	plan.type = type;
+	for (const size_t c : order) {
+		plan.clauses.push_back(clauses[c]);
+		plan.selectivity.push_back(fraction(counts.passed[c]));
+	}
+	plan.combined_selectivity = fraction(counts.combined);
+	plan.sample_size = counts.total;
+	const bool selective_first = !plan.clauses.empty() && plan.selectivity[0] < options.sparse_threshold;
+	plan.strategy = selective_first && plan.clauses.size() > 1 ? ScanStrategy::Sparse : ScanStrategy::Dense;
+	return plan;
+}
+
+}  // namespace
+
+ScanPlan PlanScan(HANDLE process, const std::vector<MemoryRegion> &regions, const ScanType type,
+	const std::vector<ScanClause> &clauses, const ScanPlanOptions &options)
+{
+	CheckOptions(options);
+	const SampleCounts counts = VisitScanType(type, [&]<typename T>(std::type_identity<T>) {
+		return SampleRegions<T>(process, regions, clauses, options);
+	});
+	return MakePlan(type, clauses, counts, options);
+}
+
+ScanPlan PlanScan(HANDLE process, const std::vector<MemoryRegion> &regions, const std::vector<IntPtr> &valid_addresses,
+	const ScanType type, const std::vector<ScanClause> &clauses, const ScanPlanOptions &options)
+{
+	CheckOptions(options);
+	const SampleCounts counts = VisitScanType(type, [&]<typename T>(std::type_identity<T>) {
+		return SampleCandidates<T>(process, regions, valid_addresses, clauses, options);
+	});
+	return MakePlan(type, clauses, counts, options);
+}
+
+std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions, const ScanPlan &plan)
+{
+	return VisitScanType(plan.type, [&]<typename T>(std::type_identity<T>) {
+		return NextScan<T>(process, regions, PlannedFilter<T>(plan));
+	});
+}
+
+void NextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses,
+	const ScanPlan &plan, const ScanTuning &tuning)
+{
+	VisitScanType(plan.type, [&]<typename T>(std::type_identity<T>) {
+		NextScan<T>(process, regions, valid_addresses, PlannedFilter<T>(plan), tuning);
+	});
+}
+
+}  // namespace memory_scanner
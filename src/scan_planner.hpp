@@ -0,0 +1,196 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "memory_scanner.hpp"
+#include "scan_kernels.hpp"
+#include "scan_types.hpp"
+#include "typed_scan.hpp"
+
+namespace memory_scanner
+{
+
+// One comparison of a filter made of several, all of which must hold.
+class ScanClause
+{
+public:
+	CompareOp op;
+	ScanValue value;
+};
+
+// How a planned filter evaluates its clauses within each block of 64 values.
+enum class ScanStrategy : std::uint8_t {
+	// Every clause is evaluated for the whole block and the masks are combined. Best when the clauses keep many values,
+	// since all of it vectorizes.
+	Dense,
+	// The first clause is evaluated for the whole block and the others only for the values still passing, one by one
+	// once few are left. Best when the first clause rejects almost everything.
+	Sparse,
+};
+
+// The order and strategy chosen for a filter by `PlanScan`.
+class ScanPlan
+{
+public:
+	ScanType type;
+	// Most selective first.
+	std::vector<ScanClause> clauses;
+	// The estimated fraction of values each clause keeps on its own, in the order of `clauses`.
+	std::vector<double> selectivity;
+	// The estimated fraction of values the whole filter keeps.
+	double combined_selectivity = 1;
+	ScanStrategy strategy = ScanStrategy::Dense;
+	// The number of values the estimates are based on.
+	size_t sample_size = 0;
+};
+
+class ScanPlanOptions
+{
+public:
+	// The fraction of the region bytes to re-read as a sample, greater than 0 and at most 1.
+	double sample_fraction = 1.0 / 256;
+	// The sample is taken in chunks of this many bytes spread evenly over the regions.
+	IntPtr sample_chunk = 4096;
+	// The sparse strategy is chosen when the first clause is estimated to keep less than this fraction of values.
+	double sparse_threshold = 1.0 / 16;
+};
+
+// Estimates how selective each clause is by re-reading a small sample of `regions` and comparing it to the captured
+// data, then orders the clauses from most to least selective and picks a strategy. The regions are not modified.
+ScanPlan PlanScan(HANDLE process, const std::vector<MemoryRegion> &regions, ScanType type,
+	const std::vector<ScanClause> &clauses, const ScanPlanOptions &options = ScanPlanOptions());
+
+// Same as above, but samples `valid_addresses` for a following restricted scan.
+ScanPlan PlanScan(HANDLE process, const std::vector<MemoryRegion> &regions, const std::vector<IntPtr> &valid_addresses,
+	ScanType type, const std::vector<ScanClause> &clauses, const ScanPlanOptions &options = ScanPlanOptions());
+
+// Same as `NextScan<T>` with the filter described by `plan`.
+std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions, const ScanPlan &plan);
+
+// Same as above, but restricted to `valid_addresses` like the restricted `NextScan<T>`.
+void NextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses,
+	const ScanPlan &plan, const ScanTuning &tuning = ScanTuning());
+
+// The filter of a ScanPlan for the stored type T. Usable with any scan.
+template<typename T>
+class PlannedFilter
+{
+public:
+	explicit PlannedFilter(const ScanPlan &plan);
+
+	std::uint64_t EvaluateBlock(const T *prev, const T *cur, size_t n) const;
+
+	bool operator()(const T &prev, const T &cur) const;
+
+private:
+	std::vector<ScanClause> clauses;
+	ScanStrategy strategy;
+};
+
+//
+// Implementations of templated functions below...
+//
+
+namespace internal
+{
+
+// Below this many passing values the sparse strategy evaluates the remaining clauses value by value.
+constexpr int sparse_lane_limit = 8;
+
+template<typename T>
+using ClauseBlockKernel = std::uint64_t (*)(const T *, const T *, size_t, const ScanValue &);
+
+template<typename T>
+using ClauseKernel = bool (*)(const T &, const T &, const ScanValue &);
+
+template<typename T, CompareOp op>
+std::uint64_t ClauseBlock(const T *const prev, const T *const cur, const size_t n, const ScanValue &value)
+{
+	return EvaluateBlock(prev, cur, n, CompareFilter<T, op>{ value.Get<Scalar<T>>() });
+}
+
+template<typename T, CompareOp op>
+bool ClauseSingle(const T &prev, const T &cur, const ScanValue &value)
+{
+	return CompareFilter<T, op>{ value.Get<Scalar<T>>() }(prev, cur);
+}
+
+template<typename T, size_t... ops>
+constexpr std::array<ClauseBlockKernel<T>, compare_op_count> MakeClauseBlockKernels(std::index_sequence<ops...>)
+{
+	return { &ClauseBlock<T, static_cast<CompareOp>(ops)>... };
+}
+
+template<typename T, size_t... ops>
+constexpr std::array<ClauseKernel<T>, compare_op_count> MakeClauseKernels(std::index_sequence<ops...>)
+{
+	return { &ClauseSingle<T, static_cast<CompareOp>(ops)>... };
+}
+
+// Evaluates one clause over a block, running the kernel compiled for its comparison.
+template<typename T>
+std::uint64_t EvaluateClauseBlock(const ScanClause &clause, const T *const prev, const T *const cur, const size_t n)
+{
+	static constexpr auto kernels = MakeClauseBlockKernels<T>(std::make_index_sequence<compare_op_count>());
+	return kernels[static_cast<size_t>(clause.op)](prev, cur, n, clause.value);
+}
+
+template<typename T>
+bool EvaluateClause(const ScanClause &clause, const T &prev, const T &cur)
+{
+	static constexpr auto kernels = MakeClauseKernels<T>(std::make_index_sequence<compare_op_count>());
+	return kernels[static_cast<size_t>(clause.op)](prev, cur, clause.value);
+}
+
+}  // namespace internal
+
+template<typename T>
+PlannedFilter<T>::PlannedFilter(const ScanPlan &plan) : clauses(plan.clauses), strategy(plan.strategy)
+{
+}
+
+template<typename T>
+std::uint64_t PlannedFilter<T>::EvaluateBlock(const T *const prev, const T *const cur, const size_t n) const
+{
+	std::uint64_t mask = n == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << n) - 1;
+	for (const ScanClause &clause : clauses) {
+		if (strategy == ScanStrategy::Sparse) {
+			if (mask == 0) {
+				break;
+			}
+			if (std::popcount(mask) < internal::sparse_lane_limit) {
+				for (std::uint64_t rest = mask; rest != 0; rest &= rest - 1) {
+					const int i = std::countr_zero(rest);
+					if (!internal::EvaluateClause(clause, prev[i], cur[i])) {
+						mask &= ~(std::uint64_t(1) << i);
+					}
+				}
+				continue;
+			}
+		}
+		mask &= internal::EvaluateClauseBlock(clause, prev, cur, n);
+	}
+	return mask;
+}
+
+template<typename T>
+bool PlannedFilter<T>::operator()(const T &prev, const T &cur) const
+{
+	for (const ScanClause &clause : clauses) {
+		if (!internal::EvaluateClause(clause, prev, cur)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+}  // namespace memory_scanner
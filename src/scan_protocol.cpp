@@ -0,0 +1,111 @@
+#include "scan_protocol.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+namespace
+{
+
+void WriteAll(HANDLE pipe, const char *data, size_t length)
+{
+	while (length != 0) {
+		DWORD written = 0;
+		if (!WriteFile(pipe, data, static_cast<DWORD>(length), &written, nullptr)) {
+			const DWORD ec = GetLastError();
+			throw MemoryScannerException("Cannot write to pipe", ec);
+		}
+		data += written;
+		length -= written;
+	}
+}
+
+// Returns false if the pipe was closed before anything was read.
+bool ReadAll(HANDLE pipe, char *data, size_t length)
+{
+	bool started = false;
+	while (length != 0) {
+		DWORD read = 0;
+		if (!ReadFile(pipe, data, static_cast<DWORD>(length), &read, nullptr)) {
+			const DWORD ec = GetLastError();
+			if (!started && ec == ERROR_BROKEN_PIPE) {
+				return false;
+			}
+			throw MemoryScannerException("Cannot read from pipe", ec);
+		}
+		if (read == 0) {
+			if (!started) {
+				return false;
+			}
+			throw MemoryScannerException("Pipe closed in the middle of a message");
+		}
+		started = true;
+		data += read;
+		length -= read;
+	}
+	return true;
+}
+
+}  // namespace
+
+void MessageWriter::PutString(const std::string_view text)
+{
+	Put(static_cast<std::uint32_t>(text.size()));
+	bytes.insert(bytes.end(), text.begin(), text.end());
+}
+
+std::string MessageReader::GetString()
+{
+	const std::uint32_t length = Get<std::uint32_t>();
+	std::string text(length, '\0');
+	Take(text.data(), length);
+	return text;
+}
+
+void MessageReader::Take(void *const dest, const size_t length)
+{
+	if (bytes.size() - position < length) {
+		throw MemoryScannerException("Message is truncated");
+	}
+	std::memcpy(dest, bytes.data() + position, length);
+	position += length;
+}
+
+void WriteMessage(HANDLE pipe, const std::vector<char> &message)
+{
+	if (message.size() > max_message_size) {
+		throw MemoryScannerException("Message is too large");
+	}
+	const std::uint32_t length = static_cast<std::uint32_t>(message.size());
+	WriteAll(pipe, reinterpret_cast<const char *>(&length), sizeof(length));
+	WriteAll(pipe, message.data(), message.size());
+}
+
+bool ReadMessage(HANDLE pipe, std::vector<char> &message)
+{
+	std::uint32_t length = 0;
+	if (!ReadAll(pipe, reinterpret_cast<char *>(&length), sizeof(length))) {
+		return false;
+	}
+	if (length > max_message_size) {
+		throw MemoryScannerException("Message is too large");
+	}
+	message.resize(length);
+	if (length != 0 && !ReadAll(pipe, message.data(), length)) {
+		throw MemoryScannerException("Pipe closed in the middle of a message");
+	}
+	return true;
+}
+
+}  // namespace memory_scanner
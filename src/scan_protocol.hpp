@@ -0,0 +1,111 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+
+// The pipe `memory_scan_daemon` serves by default.
+constexpr wchar_t default_pipe_name[] = L"\\\\.\\pipe\\memory_scanner";
+
+// Messages larger than this are rejected. Large results go through shared memory instead.
+constexpr std::uint32_t max_message_size = std::uint32_t(1) << 20;
+
+// The first byte of every request. The fields that follow are listed per type, see `ScanClient` for their meaning.
+enum class RequestType : std::uint8_t {
+	// u32 pid. Reply: u32 target.
+	Attach,
+	// u32 target. Reply: nothing.
+	Detach,
+	// u32 target. Reply: u64 region count, u64 bytes captured.
+	InitialScan,
+	// u32 target, u8 ScanType, u8 CompareOp, ScanValue. Reply: u64 candidate count.
+	NextScan,
+	// u32 target. Reply: u64 candidate count, u64 handle of a file mapping holding the candidates as IntPtrs. The
+	// handle is valid in the client, which must close it, and 0 when there are no candidates.
+	Candidates,
+	// u32 target, u64 address, u8 size. Reply: nothing.
+	Watch,
+	// u32 target. Reply: u32 count, then per change u64 address, u8 size, u64 old value, u64 new value, i64
+	// nanoseconds of steady_clock time. Changes that do not fit one reply are left for the next one.
+	PollChanges,
+};
+
+// The first byte of every reply. An error is followed by its message as a string.
+enum class ReplyStatus : std::uint8_t {
+	Ok,
+	Error,
+};
+
+// Builds a message out of fixed size fields in native byte order, since both ends run on the same machine. Strings
+// are a u32 length followed by their bytes.
+class MessageWriter
+{
+public:
+	template<typename V>
+	void Put(const V &value);
+
+	void PutString(std::string_view text);
+
+	std::vector<char> bytes;
+};
+
+// Takes apart a message built by `MessageWriter`. Throws if the message is shorter than what is taken from it.
+class MessageReader
+{
+public:
+	explicit MessageReader(const std::vector<char> &bytes) : bytes(bytes) {}
+
+	template<typename V>
+	V Get();
+
+	std::string GetString();
+
+private:
+	void Take(void *dest, size_t length);
+
+	const std::vector<char> &bytes;
+	size_t position = 0;
+};
+
+// Sends a message over a pipe in byte mode, prefixed with its length.
+void WriteMessage(HANDLE pipe, const std::vector<char> &message);
+
+// Receives a message sent by `WriteMessage`. Returns false if the other end closed the pipe before the message began.
+bool ReadMessage(HANDLE pipe, std::vector<char> &message);
+
+//
+// Implementations of templated functions below...
+//
+
+template<typename V>
+void MessageWriter::Put(const V &value)
+{
+	static_assert(std::is_trivially_copyable_v<V>, "Only plain values can be sent as is");
+	const size_t at = bytes.size();
+	bytes.resize(at + sizeof(V));
+	std::memcpy(bytes.data() + at, &value, sizeof(V));
+}
+
+template<typename V>
+V MessageReader::Get()
+{
+	static_assert(std::is_trivially_copyable_v<V>, "Only plain values can be received as is");
+	V value;
+	Take(&value, sizeof(V));
+	return value;
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,266 @@
+#include "scan_service.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <exception>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "address_watcher.hpp"
+#include "change_stream.hpp"
+#include "memory_scanner.hpp"
+#include "memory_scanner_exception.hpp"
+#include "multi_target_scan.hpp"
+#include "scan_protocol.hpp"
+#include "scan_types.hpp"
+#include "typed_scan.hpp"
+
+namespace memory_scanner
+{
+namespace
+{
+
+// Keeps a reply to PollChanges well below `max_message_size`. The changes beyond stay queued for the next request.
+constexpr size_t max_changes_per_reply = 4096;
+
+}  // namespace
+
+// An attached process. `scan` is guarded by `mutex`. The watcher lives on its own thread, which is started by the
+// first watch and picks up new watches from `pending_watches` between polls.
+class ScanService::Target
+{
+public:
+	explicit Target(HANDLE process) : process(process), changes(ChangeOptions()) { scan.process = process; }
+
+	~Target()
+	{
+		stopping = true;
+		if (poller.joinable()) {
+			poller.join();
+		}
+		CloseHandle(process);
+	}
+
+	void Watch(const IntPtr address, const size_t size)
+	{
+		const std::lock_guard lock(watch_mutex);
+		pending_watches.emplace_back(address, size);
+		if (!poller.joinable()) {
+			poller = std::thread([this] { Poll(); });
+		}
+	}
+
+	HANDLE process;
+	std::mutex mutex;
+	ScanTarget scan;
+	ChangeStream changes;
+
+private:
+	static ChangeStreamOptions ChangeOptions()
+	{
+		ChangeStreamOptions options;
+		options.max_batch = max_changes_per_reply;
+		return options;
+	}
+
+	void Poll()
+	{
+		AddressWatcher watcher(process);
+		watcher.Run(PublishTo(changes), [this, &watcher] {
+			const std::lock_guard lock(watch_mutex);
+			for (const auto &[address, size] : pending_watches) {
+				watcher.Watch(address, size);
+			}
+			pending_watches.clear();
+			return !stopping;
+		});
+	}
+
+	std::mutex watch_mutex;
+	std::vector<std::pair<IntPtr, size_t>> pending_watches;
+	std::atomic<bool> stopping = false;
+	std::thread poller;
+};
+
+ScanSession::~ScanSession()
+{
+	if (client_process != nullptr) {
+		CloseHandle(client_process);
+	}
+}
+
+ScanService::ScanService(WorkStealingPool &pool) : pool(pool)
+{
+}
+
+ScanService::~ScanService() = default;
+
+std::shared_ptr<ScanService::Target> ScanService::FindTarget(const std::uint32_t id)
+{
+	const std::lock_guard lock(targets_mutex);
+	const auto it = targets.find(id);
+	if (it == targets.end()) {
+		throw MemoryScannerException("Target is not attached");
+	}
+	return it->second;
+}
+
+std::vector<char> ScanService::Handle(const std::vector<char> &request, ScanSession &session)
+{
+	MessageWriter reply;
+	reply.Put(ReplyStatus::Ok);
+	try {
+		MessageReader reader(request);
+		const RequestType type = reader.Get<RequestType>();
+		const std::uint32_t id = reader.Get<std::uint32_t>();
+		switch (type) {
+		case RequestType::Attach: {
+			const std::lock_guard lock(targets_mutex);
+			if (!targets.contains(id)) {
+				const HANDLE process = OpenProcess(PROCESS_VM_READ | PROCESS_QUERY_INFORMATION, FALSE, id);
+				if (process == nullptr) {
+					const DWORD ec = GetLastError();
+					throw MemoryScannerException("Could not get process handle", ec);
+				}
+				targets.emplace(id, std::make_shared<Target>(process));
+			}
+			reply.Put(id);
+			break;
+		}
+		case RequestType::Detach: {
+			// Destroying the target waits for its watcher thread to finish a poll, so it happens outside of the lock.
+			std::shared_ptr<Target> detached;
+			{
+				const std::lock_guard lock(targets_mutex);
+				const auto it = targets.find(id);
+				if (it != targets.end()) {
+					detached = std::move(it->second);
+					targets.erase(it);
+				}
+			}
+			break;
+		}
+		case RequestType::InitialScan: {
+			const std::shared_ptr<Target> target = FindTarget(id);
+			const std::lock_guard lock(target->mutex);
+			std::vector<ScanTarget> scans(1);
+			scans[0].process = target->process;
+			{
+				const std::lock_guard pool_lock(pool_mutex);
+				InitialScanAll(pool, scans);
+			}
+			target->scan = std::move(scans[0]);
+			std::uint64_t bytes = 0;
+			for (const MemoryRegion &region : target->scan.regions) {
+				bytes += region.length;
+			}
+			reply.Put(static_cast<std::uint64_t>(target->scan.regions.size()));
+			reply.Put(bytes);
+			break;
+		}
+		case RequestType::NextScan: {
+			const ScanType scan_type = reader.Get<ScanType>();
+			const CompareOp op = reader.Get<CompareOp>();
+			const ScanValue value = reader.Get<ScanValue>();
+			if (static_cast<size_t>(scan_type) >= ScanTypes::size || static_cast<size_t>(op) >= compare_op_count) {
+				throw MemoryScannerException("Unknown scan type or comparison");
+			}
+			const std::shared_ptr<Target> target = FindTarget(id);
+			const std::lock_guard lock(target->mutex);
+			ScanTarget &scan = target->scan;
+			if (scan.has_candidates) {
+				NextScan(scan.process, scan.regions, scan.valid_addresses, scan_type, op, value);
+			} else {
+				scan.valid_addresses = NextScan(scan.process, scan.regions, scan_type, op, value);
+				scan.has_candidates = true;
+			}
+			reply.Put(static_cast<std::uint64_t>(scan.valid_addresses.size()));
+			break;
+		}
+		case RequestType::Candidates: {
+			const std::shared_ptr<Target> target = FindTarget(id);
+			const std::lock_guard lock(target->mutex);
+			const std::vector<IntPtr> &addresses = target->scan.valid_addresses;
+			if (addresses.empty()) {
+				reply.Put(std::uint64_t(0));
+				reply.Put(std::uint64_t(0));
+				break;
+			}
+			if (session.client_process == nullptr) {
+				throw MemoryScannerException("Cannot hand over results to a client of unknown process");
+			}
+			// The mapping is unnamed and only ever reachable through the handle duplicated into the client, so no
+			// other process can open or squat on it.
+			const std::uint64_t size = addresses.size() * sizeof(IntPtr);
+			const HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+				static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+			if (mapping == nullptr) {
+				const DWORD ec = GetLastError();
+				throw MemoryScannerException("Cannot create result mapping", ec);
+			}
+			void *const view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+			if (view == nullptr) {
+				const DWORD ec = GetLastError();
+				CloseHandle(mapping);
+				throw MemoryScannerException("Cannot map result mapping", ec);
+			}
+			std::memcpy(view, addresses.data(), size);
+			UnmapViewOfFile(view);
+			HANDLE client_mapping = nullptr;
+			const BOOL duplicated = DuplicateHandle(GetCurrentProcess(), mapping, session.client_process,
+				&client_mapping, FILE_MAP_READ, FALSE, 0);
+			const DWORD ec = GetLastError();
+			CloseHandle(mapping);
+			if (!duplicated) {
+				throw MemoryScannerException("Cannot hand over result mapping", ec);
+			}
+			reply.Put(static_cast<std::uint64_t>(addresses.size()));
+			reply.Put(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(client_mapping)));
+			break;
+		}
+		case RequestType::Watch: {
+			const IntPtr address = reader.Get<std::uint64_t>();
+			const size_t size = reader.Get<std::uint8_t>();
+			if (size == 0 || size > sizeof(std::uint64_t)) {
+				throw MemoryScannerException("Watched values are 1 to 8 bytes");
+			}
+			FindTarget(id)->Watch(address, size);
+			break;
+		}
+		case RequestType::PollChanges: {
+			std::vector<ValueChange> batch;
+			FindTarget(id)->changes.NextBatch(batch, std::chrono::milliseconds(0));
+			reply.Put(static_cast<std::uint32_t>(batch.size()));
+			for (const ValueChange &change : batch) {
+				reply.Put(static_cast<std::uint64_t>(change.address));
+				reply.Put(static_cast<std::uint8_t>(change.size));
+				reply.Put(change.old_value);
+				reply.Put(change.new_value);
+				reply.Put(static_cast<std::int64_t>(
+					std::chrono::duration_cast<std::chrono::nanoseconds>(change.time.time_since_epoch()).count()));
+			}
+			break;
+		}
+		default:
+			throw MemoryScannerException("Unknown request");
+		}
+	} catch (const std::exception &e) {
+		// Anything else thrown, such as bad_alloc for a huge snapshot, is reported the same way rather than ending the
+		// thread of the client.
+		reply.bytes.clear();
+		reply.Put(ReplyStatus::Error);
+		reply.PutString(e.what());
+	}
+	return reply.bytes;
+}
+
+}  // namespace memory_scanner
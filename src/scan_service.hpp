@@ -0,0 +1,63 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace memory_scanner
+{
+
+// What the service keeps for one client connection between requests.
+class ScanSession
+{
+public:
+	ScanSession() = default;
+	~ScanSession();
+
+	ScanSession(const ScanSession &) = delete;
+	ScanSession &operator=(const ScanSession &) = delete;
+
+	// The process of the client, opened with PROCESS_DUP_HANDLE so results can be handed over as handles valid there.
+	// Set by whoever accepts the connection, results sent through shared memory fail without it.
+	HANDLE client_process = nullptr;
+};
+
+// The state behind `memory_scan_daemon`: a snapshot, candidate set and watch list per attached process, shared by
+// every client. A target is the process id, attaching to a process that is already attached reuses its state. Safe to
+// call from one thread per client.
+class ScanService
+{
+public:
+	// `pool` reads snapshots. Its workers are shared by every client, one snapshot at a time.
+	explicit ScanService(WorkStealingPool &pool);
+	~ScanService();
+
+	ScanService(const ScanService &) = delete;
+	ScanService &operator=(const ScanService &) = delete;
+
+	// Handles one request encoded as described by `RequestType` and returns the encoded reply. Errors, including
+	// malformed requests and any other std::exception, are reported in the reply rather than thrown.
+	std::vector<char> Handle(const std::vector<char> &request, ScanSession &session);
+
+private:
+	class Target;
+
+	std::shared_ptr<Target> FindTarget(std::uint32_t id);
+
+	WorkStealingPool &pool;
+	// Guards using `pool`, whose Wait covers every task submitted.
+	std::mutex pool_mutex;
+	// Guards `targets`.
+	std::mutex targets_mutex;
+	std::map<std::uint32_t, std::shared_ptr<Target>> targets;
+};
+
+}  // namespace memory_scanner
@@ -0,0 +1,55 @@
+#include "scan_types.hpp"
+
+#include <intrin.h>
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+namespace memory_scanner
+{
+
+std::optional<ScanType> ParseScanType(const std::string_view name)
+{
+	for (size_t i = 0; i < scan_type_names.size(); ++i) {
+		if (scan_type_names[i] == name) {
+			return static_cast<ScanType>(i);
+		}
+	}
+	return std::nullopt;
+}
+
+size_t ScanTypeSize(const ScanType type)
+{
+	return VisitScanType(type, []<typename T>(std::type_identity<T>) { return sizeof(T); });
+}
+
+namespace internal
+{
+
+bool HasAvx2()
+{
+	static const bool has_avx2 = [] {
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+		__cpuid(info, 1);
+		// The CPU must support AVX and the OS must save the upper halves of the registers across context switches, see
+		// XGETBV.
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}();
+	return has_avx2;
+}
+
+}  // namespace internal
+
+}  // namespace memory_scanner
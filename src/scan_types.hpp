@@ -0,0 +1,204 @@
+#pragma once
+
+#include <stdlib.h>
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace memory_scanner
+{
+
+// Reverses the byte order of an integer or floating point value.
+template<typename T>
+T ByteSwap(T value);
+
+// A value stored in the target with its bytes in big-endian order, as emulators and network buffers often do. Scan
+// with `BigEndian<T>` as the type and the filters see the bytes as stored, use `Load` to get the actual value.
+template<typename T>
+class BigEndian
+{
+public:
+	T raw;
+
+	T Load() const { return ByteSwap(raw); }
+
+	static BigEndian Store(const T value) { return BigEndian{ ByteSwap(value) }; }
+};
+
+// The value a stored type represents, which is the type itself except for byte-swapped types.
+template<typename T>
+struct ScalarOf {
+	using Type = T;
+};
+
+template<typename T>
+struct ScalarOf<BigEndian<T>> {
+	using Type = T;
+};
+
+template<typename T>
+using Scalar = typename ScalarOf<T>::Type;
+
+// Whether T is stored with its bytes in a different order than the machine uses.
+template<typename T>
+constexpr bool is_byte_swapped = !std::is_same_v<T, Scalar<T>>;
+
+// Returns the value a stored value represents.
+template<typename T>
+Scalar<T> LoadScalar(const T &stored)
+{
+	if constexpr (std::is_arithmetic_v<T>) {
+		return stored;
+	} else {
+		return stored.Load();
+	}
+}
+
+// Same as LoadScalar for `n` values at once. With AVX2 byte-swapped values are converted 32 bytes at a time with a
+// single shuffle, which is what lets big-endian scans run as fast as native ones.
+template<typename T>
+void LoadScalars(const T *stored, size_t n, Scalar<T> *out);
+
+template<typename... Ts>
+struct TypeList {
+	static constexpr size_t size = sizeof...(Ts);
+};
+
+// Every type that can be chosen at runtime, in the order of `ScanType`.
+using ScanTypes = TypeList<std::int8_t, std::int16_t, std::int32_t, std::int64_t, std::uint8_t, std::uint16_t,
+	std::uint32_t, std::uint64_t, float, double, BigEndian<std::int16_t>, BigEndian<std::int32_t>,
+	BigEndian<std::int64_t>, BigEndian<std::uint16_t>, BigEndian<std::uint32_t>, BigEndian<std::uint64_t>,
+	BigEndian<float>, BigEndian<double>>;
+
+// A type from `ScanTypes` chosen at runtime, for example from the command line.
+enum class ScanType : std::uint8_t {
+	Int8,
+	Int16,
+	Int32,
+	Int64,
+	UInt8,
+	UInt16,
+	UInt32,
+	UInt64,
+	Float,
+	Double,
+	Int16BE,
+	Int32BE,
+	Int64BE,
+	UInt16BE,
+	UInt32BE,
+	UInt64BE,
+	FloatBE,
+	DoubleBE,
+};
+
+// Short names of the scan types as typed by users, in the order of `ScanType`.
+constexpr std::array<std::string_view, ScanTypes::size> scan_type_names = { "i8", "i16", "i32", "i64", "u8", "u16",
+	"u32", "u64", "f32", "f64", "i16be", "i32be", "i64be", "u16be", "u32be", "u64be", "f32be", "f64be" };
+
+// Returns the type with the given short name, or nothing if there is none.
+std::optional<ScanType> ParseScanType(std::string_view name);
+
+// Returns the size in bytes of the type.
+size_t ScanTypeSize(ScanType type);
+
+// The type at `index` in a TypeList.
+template<size_t index, typename List>
+struct TypeAt;
+
+template<size_t index, typename T, typename... Ts>
+struct TypeAt<index, TypeList<T, Ts...>> : TypeAt<index - 1, TypeList<Ts...>> {
+};
+
+template<typename T, typename... Ts>
+struct TypeAt<0, TypeList<T, Ts...>> {
+	using Type = T;
+};
+
+// The C++ type of a ScanType.
+template<ScanType type>
+using ScanTypeOf = typename TypeAt<static_cast<size_t>(type), ScanTypes>::Type;
+
+// Calls `fn(std::type_identity<T>())` where T is the C++ type of `type`, and returns what it returns. Every
+// instantiation of `fn` must return the same type. This is how code picks a fully specialized template at runtime.
+template<typename Fn>
+decltype(auto) VisitScanType(ScanType type, Fn &&fn);
+
+//
+// Implementations of templated functions below...
+//
+
+namespace internal
+{
+
+template<typename Fn, size_t... indices>
+decltype(auto) VisitScanType(const size_t index, Fn &fn, std::index_sequence<indices...>)
+{
+	using Result = decltype(fn(std::type_identity<typename TypeAt<0, ScanTypes>::Type>()));
+	using Thunk = Result (*)(Fn &);
+	static constexpr Thunk thunks[] = { [](Fn &f) -> Result {
+		return f(std::type_identity<typename TypeAt<indices, ScanTypes>::Type>());
+	}... };
+	return thunks[index](fn);
+}
+
+// Whether the CPU and the OS support AVX2. Checked once.
+bool HasAvx2();
+
+// Reverses the bytes of each `size` byte element, with `size` 2, 4 or 8, for as many whole AVX2 vectors as fit in `n`
+// elements. Returns the number of elements done, the caller does the rest. Lives in scan_types_avx2.cpp, the only file
+// built with AVX2 enabled, and must only be called if HasAvx2.
+size_t ByteSwapVectorsAvx2(size_t size, const char *src, size_t n, char *dst);
+
+// Same as ByteSwapVectorsAvx2, but does nothing on CPUs without AVX2.
+template<size_t size>
+size_t ByteSwapVectors(const char *const src, const size_t n, char *const dst)
+{
+	return HasAvx2() ? ByteSwapVectorsAvx2(size, src, n, dst) : 0;
+}
+
+}  // namespace internal
+
+template<typename Fn>
+decltype(auto) VisitScanType(const ScanType type, Fn &&fn)
+{
+	return internal::VisitScanType(static_cast<size_t>(type), fn, std::make_index_sequence<ScanTypes::size>());
+}
+
+template<typename T>
+void LoadScalars(const T *const stored, const size_t n, Scalar<T> *const out)
+{
+	size_t i = 0;
+	if constexpr (is_byte_swapped<T>) {
+		static_assert(sizeof(T) == sizeof(Scalar<T>), "Byte-swapped types must have the size of their value");
+		i = internal::ByteSwapVectors<sizeof(T)>(reinterpret_cast<const char *>(stored), n,
+			reinterpret_cast<char *>(out));
+	}
+	for (; i < n; ++i) {
+		out[i] = LoadScalar(stored[i]);
+	}
+}
+
+template<typename T>
+T ByteSwap(const T value)
+{
+	static_assert(std::is_arithmetic_v<T>, "Only numbers can be byte swapped");
+	if constexpr (sizeof(T) == 1) {
+		return value;
+	} else if constexpr (sizeof(T) == 2) {
+		return std::bit_cast<T>(_byteswap_ushort(std::bit_cast<std::uint16_t>(value)));
+	} else if constexpr (sizeof(T) == 4) {
+		return std::bit_cast<T>(static_cast<std::uint32_t>(_byteswap_ulong(std::bit_cast<std::uint32_t>(value))));
+	} else {
+		static_assert(sizeof(T) == 8, "Unsupported size");
+		return std::bit_cast<T>(static_cast<std::uint64_t>(_byteswap_uint64(std::bit_cast<std::uint64_t>(value))));
+	}
+}
+
+}  // namespace memory_scanner
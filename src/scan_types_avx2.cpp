@@ -0,0 +1,71 @@
+// The AVX2 kernels behind `LoadScalars`. This is the only file compiled with AVX2 enabled, see CMakeLists.txt, and it
+// deliberately includes nothing that defines inline functions the rest of the program also uses, so none of them end
+// up compiled for AVX2 by accident.
+#include <immintrin.h>
+
+#include <cstddef>
+
+namespace memory_scanner
+{
+namespace internal
+{
+
+size_t ByteSwapVectorsAvx2(size_t size, const char *src, size_t n, char *dst);
+
+}  // namespace internal
+
+namespace
+{
+
+// The `_mm256_shuffle_epi8` control reversing every `size` byte element. The shuffle works within each 16 byte lane,
+// which elements never cross.
+template<size_t size>
+struct ShuffleOrder {
+	alignas(sizeof(__m256i)) char bytes[sizeof(__m256i)];
+};
+
+template<size_t size>
+constexpr ShuffleOrder<size> MakeShuffleOrder()
+{
+	ShuffleOrder<size> order{};
+	for (size_t b = 0; b < sizeof(order.bytes); ++b) {
+		order.bytes[b] = static_cast<char>((b % 16) / size * size + (size - 1 - b % size));
+	}
+	return order;
+}
+
+template<size_t size>
+size_t ByteSwap(const char *const src, const size_t n, char *const dst)
+{
+	static constexpr ShuffleOrder<size> order = MakeShuffleOrder<size>();
+	constexpr size_t per_vector = sizeof(__m256i) / size;
+	const __m256i shuffle = _mm256_load_si256(reinterpret_cast<const __m256i *>(order.bytes));
+	size_t i = 0;
+	for (; i + per_vector <= n; i += per_vector) {
+		const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + (i * size)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + (i * size)), _mm256_shuffle_epi8(value, shuffle));
+	}
+	return i;
+}
+
+}  // namespace
+
+namespace internal
+{
+
+size_t ByteSwapVectorsAvx2(const size_t size, const char *const src, const size_t n, char *const dst)
+{
+	switch (size) {
+	case 2:
+		return ByteSwap<2>(src, n, dst);
+	case 4:
+		return ByteSwap<4>(src, n, dst);
+	case 8:
+		return ByteSwap<8>(src, n, dst);
+	default:
+		return 0;
+	}
+}
+
+}  // namespace internal
+}  // namespace memory_scanner
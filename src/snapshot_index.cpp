@@ -0,0 +1,86 @@
+#include "snapshot_index.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace memory_scanner
+{
+namespace
+{
+
+// Fills the tree in order, which visits the slots in the sorted order of the regions.
+size_t BuildTree(const std::vector<MemoryRegion> &regions, std::vector<IntPtr> &tree_bases,
+	std::vector<std::uint32_t> &tree_regions, size_t next_region, const size_t slot)
+{
+	if (slot >= tree_bases.size()) {
+		return next_region;
+	}
+	next_region = BuildTree(regions, tree_bases, tree_regions, next_region, 2 * slot);
+	tree_bases[slot] = regions[next_region].base_address;
+	tree_regions[slot] = static_cast<std::uint32_t>(next_region);
+	++next_region;
+	return BuildTree(regions, tree_bases, tree_regions, next_region, 2 * slot + 1);
+}
+
+}  // namespace
+
+SnapshotIndex::SnapshotIndex(const std::vector<MemoryRegion> &regions_)
+	: regions(regions_),
+	  tree_bases(regions_.size() + 1),
+	  tree_regions(regions_.size() + 1)
+{
+	BuildTree(regions, tree_bases, tree_regions, 0, 1);
+}
+
+size_t SnapshotIndex::FindPredecessor(const IntPtr address) const
+{
+	const size_t n = regions.size();
+	// Descend to the right whenever the base is at or before the address. The path taken encodes the slot of the
+	// first base after the address in the bits of `slot` below the trailing ones.
+	size_t slot = 1;
+	while (slot <= n) {
+		// The 8 descendants three levels down share one cache line, so fetch it while walking the levels between.
+		_mm_prefetch(reinterpret_cast<const char *>(tree_bases.data() + std::min(8 * slot, n)), _MM_HINT_T0);
+		slot = 2 * slot + (tree_bases[slot] <= address);
+	}
+	slot >>= std::countr_one(slot) + 1;
+	// The predecessor comes right before the first base after the address in sorted order.
+	const size_t successor = slot == 0 ? n : tree_regions[slot];
+	return successor == 0 ? n : successor - 1;
+}
+
+const MemoryRegion *SnapshotIndex::FindRegion(const IntPtr address) const
+{
+	const size_t r = FindPredecessor(address);
+	if (r == regions.size() || !regions[r].ContainsAddress(address)) {
+		return nullptr;
+	}
+	return &regions[r];
+}
+
+bool SnapshotIndex::CopyOut(size_t r, IntPtr address, char *dest, size_t length) const
+{
+	while (length != 0) {
+		if (r == regions.size() || !regions[r].ContainsAddress(address)) {
+			return false;
+		}
+		const MemoryRegion &region = regions[r];
+		const size_t n = std::min<size_t>(length, region.base_address + region.length - address);
+		std::memcpy(dest, region.data.get() + (address - region.base_address), n);
+		dest += n;
+		address += n;
+		length -= n;
+		++r;
+	}
+	return true;
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,79 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#include "memory_scanner.hpp"
+
+namespace memory_scanner
+{
+
+// An immutable index over the regions of a snapshot for answering "what was the value at address X" without a
+// `ReRead` syscall or a linear walk over the regions. The base addresses are stored in Eytzinger (breadth-first binary
+// tree) order so every level of the search touches a predictable cache line that can be prefetched ahead of time.
+class SnapshotIndex
+{
+public:
+	// `regions` must be sorted by base address, and must be neither modified nor destroyed while the index is in use.
+	// Any scan modifies them, so build a new index after every scan.
+	explicit SnapshotIndex(const std::vector<MemoryRegion> &regions);
+
+	// Returns the region containing `address`, or nullptr if no region does.
+	const MemoryRegion *FindRegion(IntPtr address) const;
+
+	// Copies the value at `address` out of the snapshot. The value may continue into the next region if the regions
+	// are adjacent. Returns nothing if any byte of it is not in the snapshot.
+	template<typename T>
+	std::optional<T> Read(IntPtr address) const;
+
+	// Same as above, but populates `.value` from `.address` like `MemoryObject<T>::ReRead`. Returns whether it could.
+	template<typename T>
+	bool Read(MemoryObject<T> &object) const;
+
+private:
+	// Returns the index of the last region starting at or before `address`, or `regions.size()` if there is none.
+	size_t FindPredecessor(IntPtr address) const;
+
+	// Copies `length` bytes starting in `regions[r]` into `dest`, continuing into adjacent regions.
+	bool CopyOut(size_t r, IntPtr address, char *dest, size_t length) const;
+
+	const std::vector<MemoryRegion> &regions;
+	// 1-based Eytzinger layout of the base addresses, slot 0 is unused.
+	std::vector<IntPtr> tree_bases;
+	// For each slot of `tree_bases`, the index of that region in `regions`.
+	std::vector<std::uint32_t> tree_regions;
+};
+
+//
+// Implementations of templated functions below...
+//
+
+template<typename T>
+std::optional<T> SnapshotIndex::Read(const IntPtr address) const
+{
+	const size_t r = FindPredecessor(address);
+	T value;
+	if (r == regions.size() || !CopyOut(r, address, reinterpret_cast<char *>(&value), sizeof(T))) {
+		return std::nullopt;
+	}
+	return value;
+}
+
+template<typename T>
+bool SnapshotIndex::Read(MemoryObject<T> &object) const
+{
+	const std::optional<T> value = Read<T>(object.address);
+	if (!value) {
+		return false;
+	}
+	object.value = *value;
+	return true;
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,182 @@
+#include "thread_pool.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "numa.hpp"
+
+namespace memory_scanner
+{
+
+WorkStealingPool::WorkStealingPool(unsigned num_workers, const bool pin_to_numa_nodes)
+{
+	if (num_workers == 0) {
+		num_workers = std::thread::hardware_concurrency();
+	}
+	if (num_workers == 0) {
+		num_workers = 1;
+	}
+	workers.reserve(num_workers);
+	const unsigned num_nodes = NumaNodeCount();
+	for (unsigned i = 0; i < num_workers; ++i) {
+		workers.push_back(std::make_unique<Worker>());
+		if (pin_to_numa_nodes) {
+			workers.back()->numa_node = i % num_nodes;
+		}
+	}
+	// Only start the threads once every deque exists since workers steal from each other.
+	for (unsigned i = 0; i < num_workers; ++i) {
+		workers[i]->thread = std::thread(&WorkStealingPool::WorkerLoop, this, i);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard lock(state_mutex);
+		stopping = true;
+	}
+	work_available.notify_all();
+	for (auto &worker : workers) {
+		worker->thread.join();
+	}
+}
+
+unsigned WorkStealingPool::WorkerForNumaNode(const DWORD node)
+{
+	const unsigned start = next_worker++;
+	for (unsigned offset = 0; offset < workers.size(); ++offset) {
+		const unsigned index = static_cast<unsigned>((start + offset) % workers.size());
+		if (workers[index]->numa_node == node) {
+			return index;
+		}
+	}
+	return start;
+}
+
+void WorkStealingPool::Submit(const unsigned worker_hint, Task task)
+{
+	Worker &worker = *workers[worker_hint % workers.size()];
+	{
+		std::lock_guard lock(worker.mutex);
+		worker.tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard lock(state_mutex);
+		++queued;
+		++unfinished;
+	}
+	work_available.notify_one();
+}
+
+void WorkStealingPool::Submit(Task task)
+{
+	Submit(next_worker++, std::move(task));
+}
+
+void WorkStealingPool::Wait()
+{
+	std::unique_lock lock(state_mutex);
+	all_done.wait(lock, [this] { return unfinished == 0; });
+	if (first_exception != nullptr) {
+		std::exception_ptr e = nullptr;
+		std::swap(e, first_exception);
+		std::rethrow_exception(e);
+	}
+}
+
+void WorkStealingPool::WorkerLoop(const unsigned index)
+{
+	if (workers[index]->numa_node != NUMA_NO_PREFERRED_NODE) {
+		try {
+			PinCurrentThreadToNumaNode(workers[index]->numa_node);
+		} catch (...) {
+			// Still usable, just without the locality. The node is kept since other workers read it without locking.
+		}
+	}
+	for (;;) {
+		{
+			std::unique_lock lock(state_mutex);
+			work_available.wait(lock, [this] { return stopping || queued != 0; });
+			if (queued == 0) {
+				// Only reachable when stopping.
+				return;
+			}
+			// Claim one queued task. It is guaranteed to be found in some deque below.
+			--queued;
+		}
+		Task task;
+		while (!TryPop(index, task) && !TrySteal(index, task)) {
+			// Our claim guarantees a task is queued somewhere, but while we looked another worker may have taken the
+			// one we were heading for and a new one landed in a deque we already checked. Look again.
+			std::this_thread::yield();
+		}
+		std::exception_ptr e = nullptr;
+		try {
+			task();
+		} catch (...) {
+			e = std::current_exception();
+		}
+		bool finished_all = false;
+		{
+			std::lock_guard lock(state_mutex);
+			if (e != nullptr && first_exception == nullptr) {
+				first_exception = e;
+			}
+			finished_all = --unfinished == 0;
+		}
+		if (finished_all) {
+			all_done.notify_all();
+		}
+	}
+}
+
+bool WorkStealingPool::TryPop(const unsigned index, Task &task)
+{
+	Worker &worker = *workers[index];
+	std::lock_guard lock(worker.mutex);
+	if (worker.tasks.empty()) {
+		return false;
+	}
+	task = std::move(worker.tasks.back());
+	worker.tasks.pop_back();
+	return true;
+}
+
+bool WorkStealingPool::TrySteal(const unsigned index, Task &task)
+{
+	const size_t n = workers.size();
+	const DWORD own_node = workers[index]->numa_node;
+	// First steal from workers on the same node since their tasks most likely use memory of this node. Unpinned
+	// workers all share NUMA_NO_PREFERRED_NODE so they get everything in the first pass.
+	for (const bool same_node : { true, false }) {
+		for (size_t offset = 1; offset < n; ++offset) {
+			Worker &victim = *workers[(index + offset) % n];
+			if ((victim.numa_node == own_node) != same_node) {
+				continue;
+			}
+			std::lock_guard lock(victim.mutex);
+			if (!victim.tasks.empty()) {
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+}  // namespace memory_scanner
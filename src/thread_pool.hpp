@@ -0,0 +1,81 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace memory_scanner
+{
+
+// A fixed set of worker threads where every worker owns a deque of tasks. A worker pops from the back of its own deque
+// and, when that runs dry, steals from the front of the other workers' deques, so uneven task sizes still keep every
+// worker busy.
+//
+// Optionally the workers are spread over the NUMA nodes of the machine and pinned there. Region buffers read by a
+// pinned worker are bound to its node, and thieves prefer workers on their own node, so tasks submitted to a worker on
+// the node holding their data mostly filter node-local memory.
+class WorkStealingPool
+{
+public:
+	using Task = std::function<void()>;
+
+	// Passing 0 uses one worker per hardware thread. Worker i is pinned to NUMA node i % NumaNodeCount() if
+	// `pin_to_numa_nodes` is set.
+	explicit WorkStealingPool(unsigned num_workers = 0, bool pin_to_numa_nodes = false);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool &) = delete;
+	WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+	unsigned WorkerCount() const { return static_cast<unsigned>(workers.size()); }
+
+	// Returns a worker pinned to `node`, cycling through them on every call. Returns any worker if none is pinned
+	// there.
+	unsigned WorkerForNumaNode(DWORD node);
+
+	// Queues a task onto the deque of worker `worker_hint % WorkerCount()`.
+	void Submit(unsigned worker_hint, Task task);
+
+	// Queues a task onto the deques in round-robin order.
+	void Submit(Task task);
+
+	// Blocks until every submitted task has finished. If any task threw, the first exception is rethrown here after
+	// the remaining tasks have finished.
+	void Wait();
+
+private:
+	struct Worker {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+		std::thread thread;
+		DWORD numa_node = NUMA_NO_PREFERRED_NODE;
+	};
+
+	void WorkerLoop(unsigned index);
+	bool TryPop(unsigned index, Task &task);
+	bool TrySteal(unsigned index, Task &task);
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	// Guards `queued`, `unfinished`, `stopping` and `first_exception`.
+	std::mutex state_mutex;
+	std::condition_variable work_available;
+	std::condition_variable all_done;
+	size_t queued = 0;
+	size_t unfinished = 0;
+	bool stopping = false;
+	std::exception_ptr first_exception = nullptr;
+	std::atomic<unsigned> next_worker = 0;
+};
+
+}  // namespace memory_scanner
@@ -0,0 +1,107 @@
+#include "typed_scan.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "memory_scanner_exception.hpp"
+
+namespace memory_scanner
+{
+namespace
+{
+
+using Kernel = std::vector<IntPtr> (*)(HANDLE, std::vector<MemoryRegion> &, const ScanValue &);
+using RestrictedKernel = void (*)(HANDLE, std::vector<MemoryRegion> &, std::vector<IntPtr> &, const ScanValue &,
+	const ScanTuning &);
+
+template<typename T, CompareOp op>
+std::vector<IntPtr> ScanKernel(HANDLE process, std::vector<MemoryRegion> &regions, const ScanValue &value)
+{
+	return NextScan<T>(process, regions, CompareFilter<T, op>{ value.Get<Scalar<T>>() });
+}
+
+template<typename T, CompareOp op>
+void RestrictedScanKernel(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses,
+	const ScanValue &value, const ScanTuning &tuning)
+{
+	NextScan<T>(process, regions, valid_addresses, CompareFilter<T, op>{ value.Get<Scalar<T>>() }, tuning);
+}
+
+template<typename T, size_t... ops>
+constexpr std::array<Kernel, compare_op_count> KernelsFor(std::index_sequence<ops...>)
+{
+	return { &ScanKernel<T, static_cast<CompareOp>(ops)>... };
+}
+
+template<typename T, size_t... ops>
+constexpr std::array<RestrictedKernel, compare_op_count> RestrictedKernelsFor(std::index_sequence<ops...>)
+{
+	return { &RestrictedScanKernel<T, static_cast<CompareOp>(ops)>... };
+}
+
+template<typename... Ts>
+constexpr std::array<std::array<Kernel, compare_op_count>, sizeof...(Ts)> MakeKernels(TypeList<Ts...>)
+{
+	return { KernelsFor<Ts>(std::make_index_sequence<compare_op_count>())... };
+}
+
+template<typename... Ts>
+constexpr std::array<std::array<RestrictedKernel, compare_op_count>, sizeof...(Ts)> MakeRestrictedKernels(
+	TypeList<Ts...>)
+{
+	return { RestrictedKernelsFor<Ts>(std::make_index_sequence<compare_op_count>())... };
+}
+
+// One kernel per type and comparison, indexed by [ScanType][CompareOp].
+constexpr auto kernels = MakeKernels(ScanTypes());
+constexpr auto restricted_kernels = MakeRestrictedKernels(ScanTypes());
+
+void CheckDispatch(const ScanType type, const CompareOp op)
+{
+	if (static_cast<size_t>(type) >= ScanTypes::size || static_cast<size_t>(op) >= compare_op_count) {
+		throw MemoryScannerException("Unknown scan type or comparison");
+	}
+}
+
+}  // namespace
+
+std::optional<ScanValue> ParseScanValue(const ScanType type, const std::string_view text)
+{
+	return VisitScanType(type, [text]<typename T>(std::type_identity<T>) -> std::optional<ScanValue> {
+		Scalar<T> parsed{};
+		const char *const end = text.data() + text.size();
+		const std::from_chars_result result = std::from_chars(text.data(), end, parsed);
+		if (result.ec != std::errc() || result.ptr != end) {
+			return std::nullopt;
+		}
+		return ScanValue::From(parsed);
+	});
+}
+
+std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions, const ScanType type,
+	const CompareOp op, const ScanValue &value)
+{
+	CheckDispatch(type, op);
+	return kernels[static_cast<size_t>(type)][static_cast<size_t>(op)](process, regions, value);
+}
+
+void NextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses,
+	const ScanType type, const CompareOp op, const ScanValue &value, const ScanTuning &tuning)
+{
+	CheckDispatch(type, op);
+	restricted_kernels[static_cast<size_t>(type)][static_cast<size_t>(op)](process, regions, valid_addresses, value,
+		tuning);
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,139 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "memory_scanner.hpp"
+#include "scan_types.hpp"
+
+namespace memory_scanner
+{
+
+// A comparison chosen at runtime. The first six compare the current value against a given value, the others compare
+// the current value against the previous one and ignore the given value.
+enum class CompareOp : std::uint8_t {
+	Equal,
+	NotEqual,
+	Less,
+	LessEqual,
+	Greater,
+	GreaterEqual,
+	Changed,
+	Unchanged,
+	Increased,
+	Decreased,
+};
+
+constexpr size_t compare_op_count = 10;
+
+// A value of a type chosen at runtime, kept in the widest type of its kind.
+class ScanValue
+{
+public:
+	std::int64_t as_int = 0;
+	std::uint64_t as_uint = 0;
+	double as_double = 0;
+
+	template<typename S>
+	static ScanValue From(S value);
+
+	// Returns the value converted to the scalar type S.
+	template<typename S>
+	S Get() const;
+};
+
+// Parses text typed by a user as a value of `type`. Returns nothing if the text is not a number that fits.
+std::optional<ScanValue> ParseScanValue(ScanType type, std::string_view text);
+
+// The filter for one stored type and comparison. Being a plain function object it is inlined into the scan loop and
+// vectorized along with it.
+template<typename T, CompareOp op>
+class CompareFilter
+{
+public:
+	static constexpr bool loads_scalars = true;
+
+	Scalar<T> value{};
+
+	// Accepts T or, for blocks converted by the kernels, `Scalar<T>`.
+	template<typename U>
+	bool operator()(const U &prev, const U &current) const;
+};
+
+// Same as `NextScan<T>` with a `CompareFilter<T, op>`, for a type and comparison chosen at runtime. The pair is looked
+// up in a table of kernels that are each compiled for exactly one type and comparison.
+std::vector<IntPtr> NextScan(HANDLE process, std::vector<MemoryRegion> &regions, ScanType type, CompareOp op,
+	const ScanValue &value);
+
+// Same as above, but restricted to `valid_addresses` like the restricted `NextScan<T>`.
+void NextScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses, ScanType type,
+	CompareOp op, const ScanValue &value, const ScanTuning &tuning = ScanTuning());
+
+//
+// Implementations of templated functions below...
+//
+
+template<typename S>
+ScanValue ScanValue::From(const S value)
+{
+	ScanValue result;
+	if constexpr (std::is_floating_point_v<S>) {
+		result.as_double = value;
+	} else if constexpr (std::is_signed_v<S>) {
+		result.as_int = value;
+	} else {
+		result.as_uint = value;
+	}
+	return result;
+}
+
+template<typename S>
+S ScanValue::Get() const
+{
+	if constexpr (std::is_floating_point_v<S>) {
+		return static_cast<S>(as_double);
+	} else if constexpr (std::is_signed_v<S>) {
+		return static_cast<S>(as_int);
+	} else {
+		return static_cast<S>(as_uint);
+	}
+}
+
+template<typename T, CompareOp op>
+template<typename U>
+bool CompareFilter<T, op>::operator()(const U &prev, const U &current) const
+{
+	const Scalar<T> cur = LoadScalar(current);
+	if constexpr (op == CompareOp::Equal) {
+		return cur == value;
+	} else if constexpr (op == CompareOp::NotEqual) {
+		return cur != value;
+	} else if constexpr (op == CompareOp::Less) {
+		return cur < value;
+	} else if constexpr (op == CompareOp::LessEqual) {
+		return cur <= value;
+	} else if constexpr (op == CompareOp::Greater) {
+		return cur > value;
+	} else if constexpr (op == CompareOp::GreaterEqual) {
+		return cur >= value;
+	} else if constexpr (op == CompareOp::Changed) {
+		return cur != LoadScalar(prev);
+	} else if constexpr (op == CompareOp::Unchanged) {
+		return cur == LoadScalar(prev);
+	} else if constexpr (op == CompareOp::Increased) {
+		return cur > LoadScalar(prev);
+	} else {
+		static_assert(op == CompareOp::Decreased, "Unhandled CompareOp");
+		return cur < LoadScalar(prev);
+	}
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,82 @@
+#include "value_profile.hpp"
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace memory_scanner
+{
+namespace internal
+{
+
+CountMinSketch::CountMinSketch(const size_t width, const size_t depth)
+	: width(width == 0 ? 0 : std::bit_ceil(std::max<size_t>(width, 2))), depth(width == 0 ? 0 : depth),
+	  shift(64 - std::countr_zero(std::max<std::uint64_t>(this->width, 2)))
+{
+	// Odd multipliers from splitmix64 so every row hashes differently.
+	std::uint64_t state = 0x9E3779B97F4A7C15;
+	for (size_t r = 0; r < this->depth; ++r) {
+		state += 0x9E3779B97F4A7C15;
+		std::uint64_t z = state;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+		seeds.push_back((z ^ (z >> 31)) | 1);
+	}
+	counts.resize(this->width * this->depth, 0);
+}
+
+void CountMinSketch::Merge(const CountMinSketch &other)
+{
+	for (size_t i = 0; i < counts.size(); ++i) {
+		counts[i] += other.counts[i];
+	}
+}
+
+ProfileAccumulator::ProfileAccumulator(const ProfileOptions &options, const bool with_sketch)
+	: buckets(options.bucket_count, 0), sketch(with_sketch ? options.sketch_width : 0, options.sketch_depth)
+{
+}
+
+void ProfileAccumulator::MergeInto(ProfileAccumulator &total, std::vector<std::uint64_t> &candidates) const
+{
+	for (size_t i = 0; i < buckets.size(); ++i) {
+		total.buckets[i] += buckets[i];
+	}
+	total.below += below;
+	total.above += above;
+	total.unordered += unordered;
+	total.total += this->total;
+	total.sketch.Merge(sketch);
+	candidates.insert(candidates.end(), top_keys.begin(), top_keys.end());
+}
+
+}  // namespace internal
+
+double ValueProfile::EstimateInRange(const double first, const double last) const
+{
+	double estimate = 0;
+	for (size_t i = 0; i < buckets.size(); ++i) {
+		const double bucket_low = low + i * bucket_width;
+		const double covered = std::min(last, bucket_low + bucket_width) - std::max(first, bucket_low);
+		if (covered > 0) {
+			estimate += buckets[i] * (covered / bucket_width);
+		}
+	}
+	return estimate;
+}
+
+ValueProfile ProfileValues(WorkStealingPool &pool, const std::vector<MemoryRegion> &regions, const ScanType type,
+	const ProfileOptions &options)
+{
+	return VisitScanType(
+		type, [&]<typename T>(std::type_identity<T>) { return ProfileValues<T>(pool, regions, options); });
+}
+
+}  // namespace memory_scanner
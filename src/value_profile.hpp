@@ -0,0 +1,284 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "memory_scanner.hpp"
+#include "multi_target_scan.hpp"
+#include "scan_types.hpp"
+#include "thread_pool.hpp"
+#include "typed_scan.hpp"
+
+namespace memory_scanner
+{
+
+// How `ProfileValues` buckets and counts values.
+class ProfileOptions
+{
+public:
+	// The histogram splits [low, high) into `bucket_count` buckets of equal width.
+	double low = 0;
+	double high = 256;
+	size_t bucket_count = 64;
+	// How many of the most frequent values to report. 0 skips the sketch, which is the slow part of the pass.
+	size_t top_k = 16;
+	// Size of the count-min sketch estimating the frequency of each value, needed if `top_k` is not 0. The width must
+	// be at least 2 and is rounded up to a power of two, the depth must be at least 1. A wider sketch overestimates
+	// less, a deeper one is less likely to overestimate at all.
+	size_t sketch_width = size_t(1) << 14;
+	size_t sketch_depth = 4;
+	// The amount of region bytes a single task profiles.
+	IntPtr bytes_per_task = default_bytes_per_task;
+};
+
+// A value that occurs often, with an estimate of how often. The estimate is never below the true count.
+class FrequentValue
+{
+public:
+	ScanValue value;
+	std::uint64_t estimated_count;
+};
+
+// The distribution of the values of one type in a snapshot.
+class ValueProfile
+{
+public:
+	double low = 0;
+	double bucket_width = 0;
+	// buckets[i] counts the values in [low + i * bucket_width, low + (i + 1) * bucket_width).
+	std::vector<std::uint64_t> buckets;
+	std::uint64_t below = 0;
+	std::uint64_t above = 0;
+	// Values outside of any bucket because they are NaN.
+	std::uint64_t unordered = 0;
+	std::uint64_t total = 0;
+	// Most frequent first.
+	std::vector<FrequentValue> frequent;
+
+	// Estimates how many values lie in [first, last] by assuming values are spread evenly within each bucket. Useful to
+	// guess the result size of a filter before running it.
+	double EstimateInRange(double first, double last) const;
+};
+
+// Profiles every aligned T in the captured `regions` using the workers of `pool`. The regions are only read, not
+// refreshed, so this is typically run on the result of `InitialScan` to pick a selective filter.
+template<typename T>
+ValueProfile ProfileValues(WorkStealingPool &pool, const std::vector<MemoryRegion> &regions,
+	const ProfileOptions &options = ProfileOptions());
+
+// Same as above, for a type chosen at runtime.
+ValueProfile ProfileValues(WorkStealingPool &pool, const std::vector<MemoryRegion> &regions, ScanType type,
+	const ProfileOptions &options = ProfileOptions());
+
+//
+// Implementations of templated functions below...
+//
+
+namespace internal
+{
+
+// A count-min sketch over 64 bit keys. Row r counts key k in column `(k * seeds[r]) >> shift`. A width of 0 disables
+// it, other widths are rounded up to a power of two of at least 2.
+class CountMinSketch
+{
+public:
+	CountMinSketch(size_t width, size_t depth);
+
+	// Counts `key` once more and returns its new estimate.
+	std::uint64_t Add(std::uint64_t key)
+	{
+		std::uint64_t estimate = ~std::uint64_t(0);
+		for (size_t r = 0; r < depth; ++r) {
+			estimate = std::min(estimate, ++counts[r * width + Column(key, r)]);
+		}
+		return estimate;
+	}
+
+	std::uint64_t Estimate(std::uint64_t key) const
+	{
+		std::uint64_t estimate = ~std::uint64_t(0);
+		for (size_t r = 0; r < depth; ++r) {
+			estimate = std::min(estimate, counts[r * width + Column(key, r)]);
+		}
+		return estimate;
+	}
+
+	void Merge(const CountMinSketch &other);
+
+private:
+	size_t Column(const std::uint64_t key, const size_t r) const
+	{
+		return static_cast<size_t>((key * seeds[r]) >> shift);
+	}
+
+	size_t width;
+	size_t depth;
+	int shift;
+	std::vector<std::uint64_t> seeds;
+	std::vector<std::uint64_t> counts;
+};
+
+// The state of one task, or of the whole pass once the tasks are merged.
+class ProfileAccumulator
+{
+public:
+	ProfileAccumulator(const ProfileOptions &options, bool with_sketch);
+
+	// Adds the values the task found most frequent to `candidates`, and everything else to this accumulator.
+	void MergeInto(ProfileAccumulator &total, std::vector<std::uint64_t> &candidates) const;
+
+	std::vector<std::uint64_t> buckets;
+	std::uint64_t below = 0;
+	std::uint64_t above = 0;
+	std::uint64_t unordered = 0;
+	std::uint64_t total = 0;
+	CountMinSketch sketch;
+	// The keys with the highest estimates seen by this task, up to `top_k`, and those estimates.
+	std::vector<std::uint64_t> top_keys;
+	std::vector<std::uint64_t> top_estimates;
+};
+
+template<typename S>
+std::uint64_t ValueKey(const S value)
+{
+	std::uint64_t key = 0;
+	std::memcpy(&key, &value, sizeof(S));
+	return key;
+}
+
+template<typename S>
+S KeyValue(const std::uint64_t key)
+{
+	S value;
+	std::memcpy(&value, &key, sizeof(S));
+	return value;
+}
+
+// Updates the running top-K with a key whose estimate just grew.
+inline void OfferTopKey(ProfileAccumulator &acc, const std::uint64_t key, const std::uint64_t estimate,
+	const size_t top_k)
+{
+	const auto it = std::find(acc.top_keys.begin(), acc.top_keys.end(), key);
+	if (it != acc.top_keys.end()) {
+		acc.top_estimates[it - acc.top_keys.begin()] = estimate;
+		return;
+	}
+	if (acc.top_keys.size() < top_k) {
+		acc.top_keys.push_back(key);
+		acc.top_estimates.push_back(estimate);
+		return;
+	}
+	const auto lowest = std::min_element(acc.top_estimates.begin(), acc.top_estimates.end());
+	if (estimate > *lowest) {
+		acc.top_keys[lowest - acc.top_estimates.begin()] = key;
+		*lowest = estimate;
+	}
+}
+
+template<typename T>
+void ProfileRange(const T *const values, const size_t count, const ProfileOptions &options, const double inverse_width,
+	ProfileAccumulator &acc)
+{
+	using S = Scalar<T>;
+	constexpr size_t block = 256;
+	S loaded[block];
+	const double bucket_count = static_cast<double>(options.bucket_count);
+	std::uint64_t lowest_top = 0;
+	for (size_t begin = 0; begin < count; begin += block) {
+		const size_t n = std::min(block, count - begin);
+		LoadScalars(values + begin, n, loaded);
+		for (size_t i = 0; i < n; ++i) {
+			const double position = (static_cast<double>(loaded[i]) - options.low) * inverse_width;
+			if (position >= 0 && position < bucket_count) {
+				++acc.buckets[static_cast<size_t>(position)];
+			} else if (position < 0) {
+				++acc.below;
+			} else if (position >= bucket_count) {
+				++acc.above;
+			} else {
+				++acc.unordered;
+			}
+		}
+		if (options.top_k == 0) {
+			continue;
+		}
+		for (size_t i = 0; i < n; ++i) {
+			const std::uint64_t key = ValueKey(loaded[i]);
+			const std::uint64_t estimate = acc.sketch.Add(key);
+			// Only look at the top-K when the value could enter it. Past the first few, a value is only offered every
+			// 16 counts, which keeps values hovering around the threshold from searching the top-K all the time.
+			const bool could_enter = estimate > lowest_top && (estimate < 16 || estimate % 16 == 0);
+			if (could_enter || acc.top_keys.size() < options.top_k) {
+				OfferTopKey(acc, key, estimate, options.top_k);
+				lowest_top = *std::min_element(acc.top_estimates.begin(), acc.top_estimates.end());
+			}
+		}
+	}
+	acc.total += count;
+}
+
+}  // namespace internal
+
+template<typename T>
+ValueProfile ProfileValues(WorkStealingPool &pool, const std::vector<MemoryRegion> &regions,
+	const ProfileOptions &options)
+{
+	using S = Scalar<T>;
+	if (options.bucket_count == 0 || !(options.high > options.low)) {
+		throw MemoryScannerException("Profile needs at least one bucket and a non-empty range");
+	}
+	if (options.top_k != 0 && (options.sketch_width < 2 || options.sketch_depth == 0)) {
+		throw MemoryScannerException("Top values need a sketch at least 2 wide and 1 deep");
+	}
+	const double inverse_width = options.bucket_count / (options.high - options.low);
+	const bool with_sketch = options.top_k != 0;
+	internal::ProfileAccumulator total(options, with_sketch);
+	std::vector<std::uint64_t> candidates;
+	std::mutex total_mutex;
+	const IntPtr bytes_per_task = std::max<IntPtr>(options.bytes_per_task / sizeof(T) * sizeof(T), sizeof(T));
+	for (const MemoryRegion &region : regions) {
+		for (IntPtr offset = 0; offset + sizeof(T) <= region.length; offset += bytes_per_task) {
+			const size_t count = (std::min(bytes_per_task, region.length - offset)) / sizeof(T);
+			const T *const values = reinterpret_cast<const T *>(region.data.get() + offset);
+			pool.Submit(pool.WorkerForNumaNode(region.data.get_deleter().numa_node), [&, values, count] {
+				internal::ProfileAccumulator acc(options, with_sketch);
+				internal::ProfileRange(values, count, options, inverse_width, acc);
+				const std::lock_guard lock(total_mutex);
+				acc.MergeInto(total, candidates);
+			});
+		}
+	}
+	pool.Wait();
+
+	ValueProfile profile;
+	profile.low = options.low;
+	profile.bucket_width = (options.high - options.low) / options.bucket_count;
+	profile.buckets = std::move(total.buckets);
+	profile.below = total.below;
+	profile.above = total.above;
+	profile.unordered = total.unordered;
+	profile.total = total.total;
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	for (const std::uint64_t key : candidates) {
+		profile.frequent.push_back(
+			FrequentValue{ ScanValue::From(internal::KeyValue<S>(key)), total.sketch.Estimate(key) });
+	}
+	std::sort(profile.frequent.begin(), profile.frequent.end(),
+		[](const FrequentValue &a, const FrequentValue &b) { return a.estimated_count > b.estimated_count; });
+	profile.frequent.resize(std::min(profile.frequent.size(), options.top_k));
+	return profile;
+}
+
+}  // namespace memory_scanner
@@ -0,0 +1,293 @@
+#pragma once
+
+#define STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "memory_scanner.hpp"
+#include "scan_kernels.hpp"
+
+namespace memory_scanner
+{
+
+// N consecutive values of T, such as the `float[3]` position of an object.
+template<typename T, size_t N>
+using Tuple = std::array<T, N>;
+
+// Keeps tuples whose every component of the current value is within `tolerance` of `target`.
+template<typename T, size_t N>
+class Near
+{
+public:
+	Tuple<T, N> target;
+	Tuple<T, N> tolerance;
+
+	bool operator()(const Tuple<T, N> &prev, const Tuple<T, N> &cur) const;
+};
+
+// Keeps tuples whose Euclidean distance between the previous and current value is within `tolerance` of `distance`.
+template<typename T, size_t N>
+class MovedBy
+{
+public:
+	MovedBy(T distance, T tolerance);
+
+	bool operator()(const Tuple<T, N> &prev, const Tuple<T, N> &cur) const;
+
+private:
+	// Squared bounds of the distance, so no square root is needed per tuple.
+	T min_squared;
+	T max_squared;
+};
+
+// Same as `NextScan<T>`, but for tuples of N consecutive values of T. `keep_if(prev, cur)` is given the previous and
+// current `Tuple<T, N>`. A tuple may start at any multiple of `sizeof(T)`, so tuples are found whatever the layout of
+// the structure holding them. The tuples are evaluated 64 at a time like single values. Tuples straddling two regions
+// are only found if `InitialScanOptions::boundary_overlap` is at least `sizeof(Tuple<T, N>) - 1`.
+template<typename T, size_t N, typename Filter>
+std::vector<IntPtr> NextTupleScan(HANDLE process, std::vector<MemoryRegion> &regions, const Filter &keep_if);
+
+// Same as above, but only considers the tuples starting at `valid_addresses`, like the restricted `NextScan<T>`.
+// Regions with few candidates are read sparsely as set by `tuning`.
+template<typename T, size_t N, typename Filter>
+void NextTupleScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses,
+	const Filter &keep_if, const ScanTuning &tuning = ScanTuning());
+
+//
+// Implementations of templated functions below...
+//
+
+template<typename T, size_t N>
+bool Near<T, N>::operator()(const Tuple<T, N> &, const Tuple<T, N> &cur) const
+{
+	bool near = true;
+	for (size_t c = 0; c < N; ++c) {
+		near &= std::abs(cur[c] - target[c]) <= tolerance[c];
+	}
+	return near;
+}
+
+template<typename T, size_t N>
+MovedBy<T, N>::MovedBy(const T distance, const T tolerance)
+{
+	const T low = std::max(distance - tolerance, T(0));
+	const T high = distance + tolerance;
+	min_squared = low * low;
+	max_squared = high * high;
+}
+
+template<typename T, size_t N>
+bool MovedBy<T, N>::operator()(const Tuple<T, N> &prev, const Tuple<T, N> &cur) const
+{
+	T squared = 0;
+	for (size_t c = 0; c < N; ++c) {
+		const T delta = cur[c] - prev[c];
+		squared += delta * delta;
+	}
+	return (squared >= min_squared) & (squared <= max_squared);
+}
+
+namespace internal
+{
+
+template<typename T, size_t N>
+Tuple<T, N> LoadTuple(const T *const values)
+{
+	Tuple<T, N> tuple;
+	for (size_t c = 0; c < N; ++c) {
+		tuple[c] = values[c];
+	}
+	return tuple;
+}
+
+// Adapts a tuple filter to the block kernels, which then walk the buffers one T at a time. Component c of the tuple at
+// i is element i + c, so each component is a plain load from a shifted pointer and the block still vectorizes.
+template<typename T, size_t N, typename Filter>
+class TupleBlockFilter
+{
+public:
+	const Filter &keep_if;
+
+	std::uint64_t EvaluateBlock(const T *const a, const T *const b, const size_t n) const
+	{
+		bool lanes[kernel_block_size];
+		for (size_t i = 0; i < n; ++i) {
+			lanes[i] = keep_if(LoadTuple<T, N>(a + i), LoadTuple<T, N>(b + i));
+		}
+		std::uint64_t mask = 0;
+		for (size_t i = 0; i < n; ++i) {
+			mask |= static_cast<std::uint64_t>(lanes[i]) << i;
+		}
+		return mask;
+	}
+};
+
+// The number of T in the first `length` bytes of a region at which a whole tuple can be read.
+template<typename T, size_t N>
+size_t TupleCount(const IntPtr length, const IntPtr readable)
+{
+	const size_t fit = readable / sizeof(T);
+	if (fit < N) {
+		return 0;
+	}
+	return std::min<size_t>((length + sizeof(T) - 1) / sizeof(T), fit - (N - 1));
+}
+
+}  // namespace internal
+
+template<typename T, size_t N, typename Filter>
+std::vector<IntPtr> NextTupleScan(HANDLE process, std::vector<MemoryRegion> &regions, const Filter &keep_if)
+{
+	std::vector<IntPtr> valid_addresses;
+	const internal::TupleBlockFilter<T, N, Filter> block_filter{ keep_if };
+	size_t new_size = 0;
+	for (size_t r = 0; r < regions.size(); ++r) {
+		MemoryRegion &region = regions[r];
+		MemoryRegion new_region;
+		new_region.base_address = region.base_address;
+		new_region.length = region.length;
+		new_region.overlap = region.overlap;
+		new_region.type = region.type;
+		new_region.allocation_base = region.allocation_base;
+		ReadRegionData(process, new_region);
+		const T *const old_ptr = reinterpret_cast<const T *>(region.data.get());
+		const T *const new_ptr = reinterpret_cast<const T *>(new_region.data.get());
+		const IntPtr overlap = std::min(region.overlap, new_region.overlap);
+		const size_t count = internal::TupleCount<T, N>(region.length, region.length + overlap);
+		const size_t previous_size = valid_addresses.size();
+		ForEachMatch(old_ptr, new_ptr, count, block_filter,
+			[&](const size_t i) { valid_addresses.push_back(new_region.base_address + (i * sizeof(T))); });
+		if (valid_addresses.size() == previous_size) {
+			continue;
+		}
+		region = std::move(new_region);
+		if (new_size != r) {
+			std::swap(regions[new_size], regions[r]);
+		}
+		++new_size;
+	}
+	regions.resize(new_size);
+	return valid_addresses;
+}
+
+namespace internal
+{
+
+// The sparse path of `ScanTupleCandidates`, like the one of `ScanRegionCandidates`.
+template<typename T, size_t N, typename Filter>
+size_t ScanSparseTupleCandidates(HANDLE process, MemoryRegion &region, IntPtr *const candidates, const size_t count,
+	const Filter &keep_if)
+{
+	std::vector<char> scratch;
+	size_t kept = 0;
+	size_t i = 0;
+	while (i < count) {
+		IntPtr begin = 0;
+		IntPtr end = 0;
+		const size_t end_i = i + GroupCandidatePages(candidates + i, count - i, sizeof(Tuple<T, N>), begin, end);
+		begin = std::max(begin, region.base_address);
+		end = std::min(end, region.base_address + region.length + region.overlap);
+		scratch.assign(end - begin, 0);
+		const SIZE_T bytes_read = ReadMemory(process, begin, scratch.data(), end - begin);
+		const IntPtr read_end = begin + bytes_read;
+		char *const old_bytes = region.data.get() + (begin - region.base_address);
+		for (size_t k = i; k < end_i; ++k) {
+			if (candidates[k] + sizeof(Tuple<T, N>) > read_end) {
+				continue;
+			}
+			Tuple<T, N> old_value;
+			Tuple<T, N> new_value;
+			std::memcpy(old_value.data(), old_bytes + (candidates[k] - begin), sizeof(Tuple<T, N>));
+			std::memcpy(new_value.data(), scratch.data() + (candidates[k] - begin), sizeof(Tuple<T, N>));
+			if (keep_if(old_value, new_value)) {
+				candidates[kept] = candidates[k];
+				++kept;
+			}
+		}
+		std::memcpy(old_bytes, scratch.data(), bytes_read);
+		i = end_i;
+	}
+	return kept;
+}
+
+// Same as `ScanRegionCandidates`, but for the tuples starting at `candidates`.
+template<typename T, size_t N, typename Filter>
+size_t ScanTupleCandidates(HANDLE process, MemoryRegion &region, IntPtr *const candidates, const size_t count,
+	const Filter &keep_if, const ScanTuning &tuning)
+{
+	if (tuning.sparse_bytes_per_candidate != 0 && count != 0 &&
+		region.length / count >= tuning.sparse_bytes_per_candidate) {
+		return ScanSparseTupleCandidates<T, N>(process, region, candidates, count, keep_if);
+	}
+	MemoryRegion new_region;
+	new_region.base_address = region.base_address;
+	new_region.length = region.length;
+	new_region.overlap = region.overlap;
+	new_region.type = region.type;
+	new_region.allocation_base = region.allocation_base;
+	ReadRegionData(process, new_region);
+	const IntPtr readable = region.length + std::min(region.overlap, new_region.overlap);
+	size_t kept = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const IntPtr offset = candidates[i] - region.base_address;
+		if (offset + sizeof(Tuple<T, N>) > readable) {
+			continue;
+		}
+		const auto *const old_values = reinterpret_cast<const T *>(region.data.get() + offset);
+		const auto *const new_values = reinterpret_cast<const T *>(new_region.data.get() + offset);
+		if (keep_if(LoadTuple<T, N>(old_values), LoadTuple<T, N>(new_values))) {
+			candidates[kept] = candidates[i];
+			++kept;
+		}
+	}
+	if (kept != 0) {
+		region = std::move(new_region);
+	}
+	return kept;
+}
+
+}  // namespace internal
+
+template<typename T, size_t N, typename Filter>
+void NextTupleScan(HANDLE process, std::vector<MemoryRegion> &regions, std::vector<IntPtr> &valid_addresses,
+	const Filter &keep_if, const ScanTuning &tuning)
+{
+	std::vector<size_t> begin;
+	std::vector<size_t> count;
+	internal::GroupCandidates(regions, valid_addresses, begin, count);
+	size_t new_size_r = 0;
+	size_t new_size_a = 0;
+	for (size_t r = 0; r < regions.size(); ++r) {
+		if (count[r] == 0) {
+			continue;
+		}
+		const size_t kept = internal::ScanTupleCandidates<T, N>(process, regions[r], &valid_addresses[begin[r]],
+			count[r], keep_if, tuning);
+		// The ranges are in address order, so the destination never overlaps unread addresses.
+		for (size_t i = 0; i < kept; ++i) {
+			valid_addresses[new_size_a + i] = valid_addresses[begin[r] + i];
+		}
+		new_size_a += kept;
+		if (kept == 0) {
+			continue;
+		}
+		if (new_size_r != r) {
+			std::swap(regions[new_size_r], regions[r]);
+		}
+		++new_size_r;
+	}
+	regions.resize(new_size_r);
+	valid_addresses.resize(new_size_a);
+}
+
+}  // namespace memory_scanner